@@ -0,0 +1,381 @@
+/**
+ * batch.c
+ * Pipelined execution of scripted input
+ *
+ * A parser thread reads and decodes commands from stdin exactly as the
+ * interactive loop does, and passes them to the executor through a lock-free
+ * single-producer single-consumer queue. The executor takes whatever has
+ * been decoded so far as one batch and avoids work that cannot be seen:
+ *
+ *  - Shapes that pass their bounds check are added to the history straight
+ *    away, but only drawn once something looks at the canvas or BATCH_LIMIT
+ *    of them are waiting, however the input was split into batches.
+ *  - A clear discards every shape still waiting to be drawn.
+ *  - Deleting a shape that is still waiting means it is never drawn. Its
+ *    points are still undrawn in order, just like deleteElement does,
+ *    because that also wipes any other shape crossing it.
+ *  - A run of r commands renders the frame once and prints it once per r.
+ *
+ * The printed output and the final canvas are the same as the interactive
+ * loop's, apart from illegal commands no longer skipping the rest of a
+ * script file.
+ *
+ * @author Dan Foad, Alexander Owen-Meehan
+ * @version 0.1.0
+ *
+ *THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *THE SOFTWARE.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <sched.h>
+#include <time.h>
+#include <pthread.h>
+#include "drawing.h"
+#include "command.h"
+#include "session.h"
+#include "batch.h"
+
+#define QUEUE_SIZE 1024				/* Must be a power of two */
+#define BATCH_LIMIT 256				/* Commands taken from the queue at once, and shapes left waiting to be drawn */
+#define END_OF_INPUT -2
+
+/** Item
+ * One decoded command, or the end of the input
+ */
+typedef struct Item {
+	char command[7];
+	int selection, param1, param2, param3, param4;
+} Item;
+
+/** Queue
+ * Ring buffer between the parser thread and the executor
+ *
+ * Only the parser moves tail and only the executor moves head
+ */
+typedef struct Queue {
+	Item items[QUEUE_SIZE];
+	atomic_size_t head, tail;
+} Queue;
+
+/** Pending
+ * A shape that has been checked and recorded but not yet drawn or undrawn
+ *
+ * element is the history entry a draw belongs to, NULL once that draw has been dropped
+ */
+typedef struct Pending {
+	int selection, param1, param2, param3, param4, delete;
+	Command *element;
+} Pending;
+
+/** backoff
+ * Waits a little for the other side of the queue to catch up
+ *
+ * @param int *spins	How many times in a row the caller has waited
+ */
+static void backoff(int *spins) {
+
+	struct timespec pause = { 0, 50000 };
+
+	if ((*spins)++ < 64) {
+		sched_yield();
+	} else {
+		nanosleep(&pause, NULL);
+	}
+}
+
+/** parser
+ * Decodes commands from stdin and queues them for the executor
+ *
+ * @param void *arg	The queue to fill
+ */
+static void* parser(void *arg) {
+
+	Queue *queue = (Queue*)arg;
+	Item item;
+	size_t tail;
+	int spins;
+
+	memset(&item, 0, sizeof(item));
+
+	do {
+		if (scanf("%6s", item.command) != 1) {
+			item.selection = END_OF_INPUT;
+		} else {
+			item.selection = findCommand(item.command);
+
+			/* Reads however many parameters the specific command needs, keeping the last ones otherwise */
+			switch (commandParams(item.selection)) {
+				case 1:
+					scanf("%d", &item.param1);
+					break;
+				case 2:
+					scanf("%d %d", &item.param1, &item.param2);
+					break;
+				case 3:
+					scanf("%d %d %d", &item.param1, &item.param2, &item.param3);
+					break;
+				case 4:
+					scanf("%d %d %d %d", &item.param1, &item.param2, &item.param3, &item.param4);
+					break;
+			}
+		}
+
+		tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+		spins = 0;
+		while (tail - atomic_load_explicit(&queue->head, memory_order_acquire) == QUEUE_SIZE) {
+			backoff(&spins);
+		}
+		queue->items[tail & (QUEUE_SIZE - 1)] = item;
+		atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+
+	} while (item.selection != END_OF_INPUT && item.selection != EXIT_COMMAND);
+
+	return NULL;
+}
+
+/** takeBatch
+ * Takes every decoded command available, waiting for at least one
+ *
+ * @param Queue *queue	The queue to drain
+ * @param Item *items	Where to copy the commands, BATCH_LIMIT long
+ * @return				The number of commands taken
+ */
+static int takeBatch(Queue *queue, Item *items) {
+
+	size_t head, tail;
+	int i, count, spins = 0;
+
+	head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+	while ((tail = atomic_load_explicit(&queue->tail, memory_order_acquire)) == head) {
+		backoff(&spins);
+	}
+
+	count = tail - head > BATCH_LIMIT ? BATCH_LIMIT : tail - head;
+	for (i = 0; i < count; i++) {
+		items[i] = queue->items[(head + i) & (QUEUE_SIZE - 1)];
+	}
+	atomic_store_explicit(&queue->head, head + count, memory_order_release);
+
+	return count;
+}
+
+/** flush
+ * Draws and undraws every pending shape in the order they were entered
+ *
+ * @param Page *page		The page to draw on
+ * @param Pending *pending	The pending shapes
+ * @param int *count		The number of pending shapes, reset to zero
+ */
+static void flush(Page *page, Pending *pending, int *count) {
+
+	int i;
+
+	for (i = 0; i < *count; i++) {
+		/* Draws whose shape was deleted before being drawn are skipped */
+		if (!pending[i].delete && pending[i].element == NULL) continue;
+
+		switch (pending[i].selection) {
+			case 4:
+				drawLine(page, pending[i].param1, pending[i].param2, pending[i].param3, pending[i].param4, pending[i].delete);
+				break;
+			case 5:
+				drawRect(page, pending[i].param1, pending[i].param2, pending[i].param3, pending[i].param4, pending[i].delete);
+				break;
+			case 6:
+				drawCircle(page, pending[i].param1, pending[i].param2, pending[i].param3, pending[i].delete);
+				break;
+		}
+	}
+	*count = 0;
+}
+
+/** check
+ * Checks a shape against the canvas without drawing it
+ *
+ * @param Page *page	The page the shape is for
+ * @param Item *item	The shape command
+ */
+static Error check(Page *page, Item *item) {
+	switch (item->selection) {
+		case 4:
+			return checkLine(page, item->param1, item->param2, item->param3, item->param4);
+		case 5:
+			return checkRect(page, item->param1, item->param2, item->param3, item->param4);
+		default:
+			return checkCircle(page, item->param1, item->param2, item->param3);
+	}
+}
+
+/** pendingSelection
+ * The dictionary position of a history entry's shape
+ *
+ * @param Command *element	The history entry
+ */
+static int pendingSelection(Command *element) {
+	if (strcmp(element->command, "line") == 0) return 4;
+	if (strcmp(element->command, "rect") == 0) return 5;
+	return 6;
+}
+
+/** batch
+ * Runs the commands on stdin through the parser thread and batch executor
+ *
+ * @return	Non-zero if the parser thread could not be started
+ */
+int batch(void) {
+
+	static Queue queue;
+	static Item items[BATCH_LIMIT];
+	static Pending pending[BATCH_LIMIT];
+	Session *session;
+	Command *element;
+	pthread_t thread;
+	char *frame = NULL;
+	size_t frameSize = 0;
+	FILE *out;
+	int i, j, count, run, waiting = 0, done = 0;
+
+	session = createSession(stdout);
+
+	if (pthread_create(&thread, NULL, parser, &queue) != 0) {
+		perror("Could not start parser");
+		deallocateSession(session);
+		return 1;
+	}
+
+	printf("Welcome to the drawing software\n");
+
+	while (!done) {
+		count = takeBatch(&queue, items);
+
+		for (i = 0; i < count && !done; i++) {
+			Item *item = &items[i];
+
+			if (item->selection == END_OF_INPUT) {
+				flush(&session->page, pending, &waiting);
+				done = 1;
+				break;
+			}
+
+			printf("> ");
+
+			if (item->selection < 0) {
+				printf("%s is an illegal command. Please ensure one of the thirteen legal commands has been entered\n", item->command);
+				continue;
+			}
+
+			if (!session->newflag) {
+				execute(session, item->selection, item->param1, item->param2, item->param3, item->param4);
+				done = item->selection == EXIT_COMMAND;
+				continue;
+			}
+
+			switch (item->selection) {
+				case 1:
+					/* Renders the frame once for the whole run of r commands */
+					for (run = 1; i + run < count && items[i + run].selection == 1; run++);
+
+					flush(&session->page, pending, &waiting);
+					out = open_memstream(&frame, &frameSize);
+
+					/* Without a buffer to render into, every r is run just as the interactive loop would */
+					if (out == NULL) {
+						for (j = 0; j < run; j++) {
+							if (j > 0) printf("> ");
+							execute(session, item->selection, item->param1, item->param2, item->param3, item->param4);
+						}
+						i += run - 1;
+						break;
+					}
+
+					session->page.out = out;
+					r(&session->page);
+					fclose(out);
+					session->page.out = stdout;
+
+					for (j = 0; j < run; j++) {
+						if (j > 0) printf("> ");
+						fwrite(frame, 1, frameSize, stdout);
+					}
+					free(frame);
+					frame = NULL;
+					i += run - 1;
+					break;
+				case 2:
+					/* Anything still waiting would be wiped anyway */
+					waiting = 0;
+					execute(session, item->selection, item->param1, item->param2, item->param3, item->param4);
+					break;
+				case 4:
+				case 5:
+				case 6:
+					if (check(&session->page, item) != NO_ERROR || (session->maxHistory > 0 && countElements(session->root) >= session->maxHistory)) {
+						/* Failed rectangles can leave sides behind, so these go through the normal path */
+						flush(&session->page, pending, &waiting);
+						execute(session, item->selection, item->param1, item->param2, item->param3, item->param4);
+						break;
+					}
+					if (waiting == BATCH_LIMIT) flush(&session->page, pending, &waiting);
+					element = createElement(item->command, item->param1, item->param2, item->param3, item->param4);
+					pushElement(session->root, element);
+
+					pending[waiting].selection = item->selection;
+					pending[waiting].param1 = element->param1;
+					pending[waiting].param2 = element->param2;
+					pending[waiting].param3 = element->param3;
+					pending[waiting].param4 = element->param4;
+					pending[waiting].delete = 0;
+					pending[waiting].element = element;
+					waiting++;
+					break;
+				case 9:
+					element = removeElement(session->root, item->param1);
+					if (element == NULL) {
+						execute(session, item->selection, item->param1, item->param2, item->param3, item->param4);
+						break;
+					}
+					for (j = 0; j < waiting; j++) {
+						if (pending[j].element == element) pending[j].element = NULL;
+					}
+					if (waiting == BATCH_LIMIT) flush(&session->page, pending, &waiting);
+
+					pending[waiting].selection = pendingSelection(element);
+					pending[waiting].param1 = element->param1;
+					pending[waiting].param2 = element->param2;
+					pending[waiting].param3 = element->param3;
+					pending[waiting].param4 = element->param4;
+					pending[waiting].delete = 1;
+					pending[waiting].element = NULL;
+					waiting++;
+					deallocateElement(element);
+					break;
+				case 3:
+				case 7:
+				case EXIT_COMMAND:
+					flush(&session->page, pending, &waiting);
+					execute(session, item->selection, item->param1, item->param2, item->param3, item->param4);
+					done = item->selection == EXIT_COMMAND;
+					break;
+				default:
+					/* new, list, view and zoom never look at the canvas */
+					execute(session, item->selection, item->param1, item->param2, item->param3, item->param4);
+					break;
+			}
+		}
+	}
+
+	pthread_join(thread, NULL);
+	deallocateSession(session);
+
+	return 0;
+}
@@ -0,0 +1,58 @@
+#!/bin/sh
+#
+# batchdiff.sh
+# Differential test of batch mode against the interactive loop
+#
+# Generates random scripts from a seed, runs each through both ./draw and
+# ./draw batch, and compares their output byte for byte. Exits non-zero on
+# any difference.
+#
+# Usage: ./batchdiff.sh [seed] [scripts]
+#
+
+seed=${1:-1}
+scripts=${2:-100}
+dir=$(mktemp -d) || exit 1
+trap 'rm -rf "$dir"' EXIT
+failed=0
+
+i=0
+while [ "$i" -lt "$scripts" ]; do
+	awk -v seed=$((seed + i)) '
+		function between(a, b) { return a + int(rand() * (b - a + 1)) }
+		BEGIN {
+			srand(seed)
+			w = between(5, 40); h = between(5, 30)
+			if (rand() < 0.9) print "new", w, h
+			n = between(1, 400)
+			for (k = 0; k < n; k++) {
+				c = rand()
+				if (c < 0.20) print "line", between(-2, w + 1), between(-2, h + 1), between(-2, w + 1), between(-2, h + 1)
+				else if (c < 0.35) print "rect", between(-2, w + 1), between(-2, h + 1), between(-2, w + 1), between(-2, h + 1)
+				else if (c < 0.45) print "circle", between(-2, w + 1), between(-2, h + 1), between(0, 8)
+				else if (c < 0.60) print "delete", between(0, 8)
+				else if (c < 0.65) print "clear"
+				else if (c < 0.75) print "r"
+				else if (c < 0.78) print "invert"
+				else if (c < 0.80) print "fill", between(0, w - 1), between(0, h - 1)
+				else if (c < 0.83) print "list"
+				else if (c < 0.85) print "zoom", between(0, 3)
+				else if (c < 0.87) print "view", between(0, 3), between(0, 3), between(1, w), between(1, h)
+				else if (c < 0.88) print "bogus"
+				else print "line", between(0, w - 1), between(0, h - 1), between(0, w - 1), between(0, h - 1)
+			}
+			print "zoom 0"; print "view 0 0", w, h; print "r"; print "exit"
+		}' > "$dir/script"
+
+	# Scripts are piped rather than redirected, as the interactive loop skips the rest of a file after an illegal command
+	cat "$dir/script" | ./draw > "$dir/interactive" 2>&1
+	cat "$dir/script" | ./draw batch > "$dir/batch" 2>&1
+	if ! cmp -s "$dir/interactive" "$dir/batch"; then
+		echo "Script $((seed + i)) differs"
+		failed=1
+	fi
+	i=$((i + 1))
+done
+
+[ "$failed" -eq 0 ] && echo "All $scripts scripts from seed $seed identical"
+exit "$failed"
@@ -17,6 +17,7 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <stdlib.h>
 #include "drawing.h"
 #include "command.h"
 
@@ -125,14 +126,14 @@ void pushElement(Command *root, Command *element) {
 	}
 }
 
-/** deleteElement
- * Deletes an element in the linked list specified by the user
+/** removeElement
+ * Cuts an element out of the linked list and renumbers the elements after it, without undrawing or freeing it
  *
- * @param Page *page					The page containing the canvas
  * @param Command *root		The first element in the linked list
- * @param int ID						The ID assigned to the element in the list that the user wishes to delete
+ * @param int ID			The ID assigned to the element in the list that is to be removed
+ * @return					The removed element, or NULL if there is no element with that ID
  */
-int deleteElement(Page *page, Command * root, int ID) {
+Command* removeElement(Command * root, int ID) {
 
 	Command *prev_element;
 	Command *temp = root;
@@ -143,7 +144,7 @@ int deleteElement(Page *page, Command * root, int ID) {
 		temp = prev_element;
 
 	/* When the element to be deleted is found, the next pointer in the element before the deleted element is given the value of the element after the deleted element and the deleted element is cut out of the list */
-	if (prev_element->ID == ID) {
+	if (ID > 0 && prev_element->ID == ID) {
 		temp->next = prev_element->next;
 		id = temp->ID;
 
@@ -152,12 +153,30 @@ int deleteElement(Page *page, Command * root, int ID) {
 			temp->ID = ++id;
 		}
 
-		undraw(page, prev_element->command, prev_element->param1, prev_element->param2, prev_element->param3, prev_element->param4);
-		deallocateElement(prev_element);
+		return prev_element;
+	}
+
+	return NULL;
+}
+
+/** deleteElement
+ * Deletes an element in the linked list specified by the user
+ *
+ * @param Page *page					The page containing the canvas
+ * @param Command *root		The first element in the linked list
+ * @param int ID						The ID assigned to the element in the list that the user wishes to delete
+ */
+int deleteElement(Page *page, Command * root, int ID) {
+
+	Command *element = removeElement(root, ID);
+
+	if (element != NULL) {
+		undraw(page, element->command, element->param1, element->param2, element->param3, element->param4);
+		deallocateElement(element);
 
 		return 1;
 	} else {
-		printf("Chosen command doesn't exist, please enter the number of a listed command\r\n");
+		fprintf(page->out, "Chosen command doesn't exist, please enter the number of a listed command\r\n");
 		return 0;
 	}
 }
@@ -165,30 +184,39 @@ int deleteElement(Page *page, Command * root, int ID) {
 /** clearLinkedlist
  * Clears the linked list, removing all elements apart from the root node
  *
- * @param Page *page		The page containing the canvas
+ * The shapes are not undrawn, this is only used once the canvas itself has been cleared
+ *
  * @param Command *root		The first element in the linked list
  */
-void clearLinkedList(Page *page, Command *root) {
-	int length = 0, i = 0;
-	Command *next = root;
-	while (next->next != NULL) {
-		next = next->next;
+void clearLinkedList(Command *root) {
+	deallocateLinkedList(root->next);
+	root->next = NULL;
+}
+
+/** countElements
+ * Counts the commands in the linked list, not including the root node
+ *
+ * @param Command *root		The first element in the linked list
+ */
+int countElements(Command *root) {
+	int length = 0;
+	while (root->next != NULL) {
+		root = root->next;
 		length++;
 	}
-	for (i = 0; i < length; i++) {
-		deleteElement(page, root, 1);
-	}
+	return length;
 }
 
 /** printlist
  * Prints the linked list, displaying all previously entered commands and their position in the list
  *
+ * @param Page *page		The page whose output stream is written to
  * @param Command * root		The first element in the linked list
  */
-void printlist(Command *root) {
+void printlist(Page *page, Command *root) {
 
 	if (root->next == 0) {
-		printf("No commands in history.\r\n");
+		fprintf(page->out, "No commands in history.\r\n");
 		return;
 	}
 	
@@ -200,19 +228,19 @@ void printlist(Command *root) {
 			root = root->next;
 
 			/* Prints the number of the command */
-			printf(" %d: ", root->ID);
+			fprintf(page->out, " %d: ", root->ID);
 
 			/* Prints the name of the command and the parameters associated with it */
 			if (strcmp(root->command, "circle") == 0)
-				printf("Circle, centre (%d, %d) and radius %d", root->param1, root->param2, root->param3);
+				fprintf(page->out, "Circle, centre (%d, %d) and radius %d", root->param1, root->param2, root->param3);
 
 			if(strcmp(root->command, "line") == 0) 
-				printf("Line from (%d, %d) to (%d, %d)", root->param1, root->param2, root->param3, root->param4);
+				fprintf(page->out, "Line from (%d, %d) to (%d, %d)", root->param1, root->param2, root->param3, root->param4);
 
 			if (strcmp(root->command, "rect") == 0)
-				printf("Rectangle from (%d, %d) to (%d, %d)", root->param1, root->param2, root->param3, root->param4);
+				fprintf(page->out, "Rectangle from (%d, %d) to (%d, %d)", root->param1, root->param2, root->param3, root->param4);
 			
-			printf("\r\n");
+			fprintf(page->out, "\r\n");
 		}
 		else {
 			return;
@@ -29,8 +29,10 @@ void deallocateElement(Command *element);
 void deallocateLinkedList(Command *root);
 Command* createElement(char *command, int param1, int param2, int param3, int param4);
 void pushElement(Command * root, Command * element);
+Command* removeElement(Command * root, int ID);
 int deleteElement(Page *page, Command * root, int ID);
-void clearLinkedList(Page *page, Command *root);
-void printlist(Command * root);
+void clearLinkedList(Command *root);
+int countElements(Command *root);
+void printlist(Page *page, Command * root);
 
 #endif
\ No newline at end of file
@@ -19,8 +19,329 @@
 
 #include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "drawing.h"
 
+#define HEADER_SIZE 4096					/* Canvas files start with "DRAW <x> <y>", padded to this size */
+#define MAP_BUDGET (64 * 1024 * 1024)		/* Bytes of a mapped canvas kept resident before cold pages are given back */
+#define MAP_CHUNK (64 * 1024)				/* A page fault maps in the aligned 16 pages around the faulting one */
+#define TILE_SHIFT 8						/* Large levels of a mapped page are kept in tiles of 256 x 256 blocks, one chunk each */
+#define TILE (1 << TILE_SHIFT)
+
+#define CHUNK_OUT 0							/* Not resident as far as the budget is concerned */
+#define CHUNK_COLD 1						/* Resident, but unused since the clock hand last passed */
+#define CHUNK_USED 2						/* Resident and used since the clock hand last passed */
+
+/** levelWidth
+ * Number of blocks across one row of a pyramid level
+ *
+ * @param Page *page	The Page struct that holds the canvas
+ * @param int level	The pyramid level, 0 being the canvas itself
+ */
+static int levelWidth(Page *page, int level) {
+	return (int)(((long)page->x + (1L << level) - 1) >> level);
+}
+
+/** levelHeight
+ * Number of block rows in a pyramid level
+ *
+ * @param Page *page	The Page struct that holds the canvas
+ * @param int level	The pyramid level, 0 being the canvas itself
+ */
+static int levelHeight(Page *page, int level) {
+	return (int)(((long)page->y + (1L << level) - 1) >> level);
+}
+
+/** tiled
+ * Whether a level is stored tile by tile rather than row by row
+ *
+ * Only levels of a mapped page more than a tile across and high are tiled, so
+ * that a shape running up the canvas touches one chunk of the file per tile
+ * rather than one per row. Smaller levels already fit in a few chunks.
+ *
+ * @param Page *page	The Page struct that holds the canvas
+ * @param int level	The pyramid level, 0 being the canvas itself
+ */
+static int tiled(Page *page, int level) {
+	return page->path != NULL && levelWidth(page, level) > TILE && levelHeight(page, level) > TILE;
+}
+
+/** levelSize
+ * Number of bytes a pyramid level is stored in, including the unused part of any tiles along its edges
+ *
+ * @param Page *page	The Page struct that holds the canvas
+ * @param int level	The pyramid level, 0 being the canvas itself
+ */
+static size_t levelSize(Page *page, int level) {
+	if (tiled(page, level)) {
+		return (size_t)((levelWidth(page, level) + TILE - 1) >> TILE_SHIFT) * ((levelHeight(page, level) + TILE - 1) >> TILE_SHIFT) * TILE * TILE;
+	}
+	return (size_t)levelWidth(page, level) * levelHeight(page, level);
+}
+
+/** cell
+ * Address of one block of a pyramid level
+ *
+ * A tiled level holds its tiles row by row, each tile holding its blocks row by row.
+ *
+ * @param Page *page	The Page struct that holds the canvas
+ * @param int level	The pyramid level, 0 being the canvas itself
+ * @param int x		The x-coordinate of the block within the level
+ * @param int y		The y-coordinate of the block within the level
+ */
+static unsigned char *cell(Page *page, int level, int x, int y) {
+	unsigned char *base = level == 0 ? (unsigned char*)page->pixels : page->pyramid[level];
+	int w = levelWidth(page, level);
+	size_t tile;
+
+	if (!tiled(page, level)) return base + (size_t)y * w + x;
+
+	tile = (size_t)(y >> TILE_SHIFT) * ((w + TILE - 1) >> TILE_SHIFT) + (x >> TILE_SHIFT);
+	return base + (tile << (2 * TILE_SHIFT)) + ((size_t)(y & (TILE - 1)) << TILE_SHIFT) + (x & (TILE - 1));
+}
+
+/** span
+ * Address of one block of a pyramid level, along with how many blocks from it along the row are stored together
+ *
+ * @param Page *page	The Page struct that holds the canvas
+ * @param int level	The pyramid level, 0 being the canvas itself
+ * @param int x		The x-coordinate of the block within the level
+ * @param int y		The y-coordinate of the block within the level
+ * @param int *length	Set to the number of blocks to the end of the row, or of the tile's row if tiled
+ */
+static unsigned char *span(Page *page, int level, int x, int y, int *length) {
+	*length = levelWidth(page, level) - x;
+	if (tiled(page, level) && *length > TILE - (x & (TILE - 1))) *length = TILE - (x & (TILE - 1));
+	return cell(page, level, x, y);
+}
+
+/** chunkOf
+ * The chunk of a mapped canvas that an address falls in, counted from the chunk holding the start of the mapping
+ *
+ * @param Page *page		The Page struct that holds the canvas
+ * @param const void *at	An address inside the mapping
+ */
+static size_t chunkOf(Page *page, const void *at) {
+	return (size_t)((uintptr_t)at / MAP_CHUNK - (uintptr_t)page->map / MAP_CHUNK);
+}
+
+/** evict
+ * Give back the pages of chunks left unused for a full turn of the clock hand, until a quarter of the budget is free
+ *
+ * The mapping is shared, so dropped pages are kept in the file and read back when next used.
+ *
+ * @param Page *page	The Page struct that holds the canvas
+ */
+static void evict(Page *page) {
+	uintptr_t first = (uintptr_t)page->map, last = first + page->mapSize, start = 0, end = 0, at;
+	size_t c;
+
+	while (page->touched > MAP_BUDGET - MAP_BUDGET / 4) {
+		c = page->hand;
+		page->hand = (page->hand + 1) % page->chunkCount;
+
+		if (page->chunks[c] == CHUNK_USED) {
+			page->chunks[c] = CHUNK_COLD;
+		} else if (page->chunks[c] == CHUNK_COLD) {
+			page->chunks[c] = CHUNK_OUT;
+			page->touched -= MAP_CHUNK;
+
+			/* Runs of cold chunks are given back together, as one call per chunk would cost more than the faults saved */
+			at = (first / MAP_CHUNK + c) * MAP_CHUNK;
+			if (at != end) {
+				if (end > start) madvise((void*)start, end - start, MADV_DONTNEED);
+				start = at > first ? at : first;
+			}
+			end = at + MAP_CHUNK < last ? at + MAP_CHUNK : last;
+		}
+	}
+	if (end > start) madvise((void*)start, end - start, MADV_DONTNEED);
+}
+
+/** touch
+ * Account for part of a mapped canvas being used, only charging the budget for chunks not already resident
+ *
+ * @param Page *page		The Page struct that holds the canvas
+ * @param const void *start	The first byte used
+ * @param size_t length		The number of bytes used
+ */
+static void touch(Page *page, const void *start, size_t length) {
+	size_t c, last;
+
+	if (page->map == NULL || length == 0) return;
+
+	last = chunkOf(page, (const char*)start + length - 1);
+	for (c = chunkOf(page, start); c <= last; c++) {
+		if (page->chunks[c] == CHUNK_OUT) {
+			if (page->touched + MAP_CHUNK > MAP_BUDGET) evict(page);
+			page->touched += MAP_CHUNK;
+		}
+		page->chunks[c] = CHUNK_USED;
+	}
+}
+
+/** advise
+ * Tell the kernel how a mapped canvas is about to be used
+ *
+ * @param Page *page	The Page struct that holds the canvas
+ * @param int advice	MADV_SEQUENTIAL before a pass over every row, MADV_RANDOM after
+ */
+static void advise(Page *page, int advice) {
+	if (page->map != NULL) madvise(page->map, page->mapSize, advice);
+}
+
+/** zero
+ * Zero part of the pyramid, a budget's worth at a time
+ *
+ * @param Page *page			The Page struct that holds the canvas
+ * @param unsigned char *start	The first byte to zero
+ * @param size_t length			The number of bytes to zero
+ */
+static void zero(Page *page, unsigned char *start, size_t length) {
+	size_t step = MAP_BUDGET / 4, done;
+
+	for (done = 0; done < length; done += step) {
+		if (step > length - done) step = length - done;
+		memset(start + done, 0, step);
+		touch(page, start + done, step);
+	}
+}
+
+/** plot
+ * Plot a single point to the canvas, keeping the zoom pyramid up to date
+ *
+ * Only the blocks whose emptiness actually changes are touched, so most
+ * writes stop after the first level.
+ *
+ * @param Page *page	The Page struct that holds the canvas
+ * @param int x		The x-coordinate of the point
+ * @param int y		The y-coordinate of the point
+ * @param char draw	The character to plot, either * or .
+ */
+void plot(Page *page, int x, int y, char draw) {
+	int l;
+	unsigned char *block;
+
+	/* In memory the point is reached through its row, a mapped page going through cell and touch instead */
+	if (page->map == NULL) {
+		if (page->canvas[y][x] == draw) return;
+		page->canvas[y][x] = draw;
+	} else {
+		block = cell(page, 0, x, y);
+		touch(page, block, 1);
+		if (*block == draw) return;
+		*block = draw;
+	}
+
+	for (l = 1; l <= page->levels; l++) {
+		if (page->map == NULL) {
+			block = &page->pyramid[l][(size_t)(y >> l) * levelWidth(page, l) + (x >> l)];
+		} else {
+			block = cell(page, l, x >> l, y >> l);
+			touch(page, block, 1);
+		}
+		if (draw == '*') {
+			if ((*block)++ != 0) break;
+		} else {
+			if (--(*block) != 0) break;
+		}
+	}
+}
+
+/** rebuildLevels
+ * Recompute the zoom pyramid from one level upwards, level 1 coming from the canvas
+ *
+ * @param Page *page	The Page struct that holds the canvas
+ * @param int from		The lowest level to recompute
+ */
+static void rebuildLevels(Page *page, int from) {
+	int l, i, j, k, n, cw, ch;
+	unsigned char *child, *out;
+
+	advise(page, MADV_SEQUENTIAL);
+
+	for (l = from; l <= page->levels; l++) {
+		zero(page, page->pyramid[l], levelSize(page, l));
+		cw = levelWidth(page, l - 1);
+		ch = levelHeight(page, l - 1);
+
+		/*
+		 * Each row is taken a run of stored blocks at a time, held in locals as stores through char
+		 * pointers would otherwise reload them every point. Runs start on an even block, and a tile
+		 * of this level covers whole tiles of the one below, so the run's parents are stored together too.
+		 */
+		for (i = 0; i < ch; i++) {
+			for (j = 0; j < cw; j += n) {
+				child = span(page, l - 1, j, i, &n);
+				out = cell(page, l, j >> 1, i >> 1);
+				if (l == 1) {
+					for (k = 0; k + 1 < n; k += 2) {
+						out[k >> 1] += (child[k] == '*') + (child[k + 1] == '*');
+					}
+					if (k < n) out[k >> 1] += child[k] == '*';
+				} else {
+					for (k = 0; k < n; k++) {
+						out[k >> 1] += child[k] != 0;
+					}
+				}
+				touch(page, child, n);
+				touch(page, out, (n + 1) >> 1);
+			}
+		}
+	}
+
+	advise(page, MADV_RANDOM);
+}
+
+/** rebuildPyramid
+ * Recompute every level of the zoom pyramid from the canvas
+ *
+ * @param Page *page	The Page struct that holds the canvas
+ */
+void rebuildPyramid(Page *page) {
+	rebuildLevels(page, 1);
+}
+
+/** block
+ * Whether a block at a given pyramid level contains any set point
+ *
+ * @param Page *page	The Page struct that holds the canvas
+ * @param int level	The pyramid level, 0 being the canvas itself
+ * @param int x		The x-coordinate of the block within the level
+ * @param int y		The y-coordinate of the block within the level
+ */
+static char block(Page *page, int level, int x, int y) {
+	unsigned char *at = cell(page, level, x, y);
+
+	touch(page, at, 1);
+	if (level == 0) return *at;
+	return *at ? '*' : '.';
+}
+
+/** checkLine
+ * Check that a line between two points fits on the canvas, without drawing it
+ *
+ * @param Page *page	The Page struct that holds the canvas
+ * @param int x1		The bottom-left x-coordinate of the line
+ * @param int y1		The bottom-left y-coordinate of the line
+ * @param int x2		The top-right x-coordinate of the line
+ * @param int y2		The top-right y-coordinate of the line
+ */
+Error checkLine(Page *page, int x1, int y1, int x2, int y2) {
+	if (x1 >= page->x || x2 >= page->x) return MAX_WIDTH;
+	if (y1 >= page->y || y2 >= page->y) return MAX_HEIGHT;
+	if (x1 < 0 || x2 < 0) return MIN_WIDTH;
+	if (y1 < 0 || y2 < 0) return MIN_HEIGHT;
+	return NO_ERROR;
+}
+
 /** drawLine
  * Draw a line between two points onto the canvas
  *
@@ -49,33 +370,37 @@ Error drawLine(Page *page, int x1, int y1, int x2, int y2, int delete) {
 		draw = '.';
 	}
 
-	if (x1 >= page->x || x2 >= page->x) return MAX_WIDTH;
-	if (y1 >= page->y || y2 >= page->y) return MAX_HEIGHT;
-	if (x1 < 0 || x2 < 0) return MIN_WIDTH;
-	if (y1 < 0 || y2 < 0) return MIN_HEIGHT;
+	Error err = checkLine(page, x1, y1, x2, y2);
+	if (err != NO_ERROR) return err;
+
+	/* A line from a point to itself would divide by zero below */
+	if (dx == 0 && dy == 0) {
+		plot(page, x1, y1, draw);
+		return NO_ERROR;
+	}
 
 	if (abs(dx) > abs(dy)) {
 		if (dx > 0) {
 			for (i = 0.0f; i <= dx; i++) {
 				j = ((i * dy) / dx) + 0.5f;
-				page->canvas[(int)(y1 + j)][(int)(x1 + i)] = draw;
+				plot(page, (int)(x1 + i), (int)(y1 + j), draw);
 			}
 		} else {
 			for (i = 0.0f; i >= dx; i--) {
 				j = ((i * dy) / dx) + 0.5f;
-				page->canvas[(int)(y1 + j)][(int)(x1 + i)] = draw;
+				plot(page, (int)(x1 + i), (int)(y1 + j), draw);
 			}
 		}
 	} else {
 		if (dy > 0) {
 			for (j = 0.0f; j <= dy; j++) {
 				i = ((j * dx) / dy) + 0.5f;
-				page->canvas[(int)(y1 + j)][(int)(x1 + i)] = draw;
+				plot(page, (int)(x1 + i), (int)(y1 + j), draw);
 			}
 		} else {
 			for (j = 0.0f; j >= dy; j--) {
 				i = ((j * dx) / dy) + 0.5f;
-				page->canvas[(int)(y1 + j)][(int)(x1 + i)] = draw;
+				plot(page, (int)(x1 + i), (int)(y1 + j), draw);
 			}
 		}
 	}
@@ -83,6 +408,25 @@ Error drawLine(Page *page, int x1, int y1, int x2, int y2, int delete) {
 	return NO_ERROR;
 }
 
+/** checkRect
+ * Check that a rectangle between two points fits on the canvas, without drawing it
+ *
+ * Gives the same error drawRect would, checking its sides in the same order
+ *
+ * @param Page *page	The Page struct that holds the canvas
+ * @param int x1		The bottom-left x-coordinate of the rectangle
+ * @param int y1		The bottom-left y-coordinate of the rectangle
+ * @param int x2		The top-right x-coordinate of the rectangle
+ * @param int y2		The top-right y-coordinate of the rectangle
+ */
+Error checkRect(Page *page, int x1, int y1, int x2, int y2) {
+	if (checkLine(page, x1, y1, x1, y2) != NO_ERROR) return checkLine(page, x1, y1, x1, y2);
+	if (checkLine(page, x1, y1, x2, y1) != NO_ERROR) return checkLine(page, x1, y1, x2, y1);
+	if (checkLine(page, x1, y2, x2, y2) != NO_ERROR) return checkLine(page, x1, y2, x2, y2);
+	if (checkLine(page, x2, y1, x2, y2) != NO_ERROR) return checkLine(page, x2, y1, x2, y2);
+	return NO_ERROR;
+}
+
 /** drawRect
  * Draw a rectangle (unfilled) between two points onto the canvas
  *
@@ -101,6 +445,51 @@ Error drawRect(Page *page, int x1, int y1, int x2, int y2, int delete) {
 	return NO_ERROR;
 }
 
+static double cosines[361], sines[361];
+static pthread_once_t anglesOnce = PTHREAD_ONCE_INIT;
+
+/** angles
+ * Work out the cosine and sine of every whole degree once, for every circle to share
+ *
+ * theta is rounded to float first, as the circle functions always have, so the points are unchanged.
+ */
+static void angles(void) {
+	float theta = 0.0f;
+	int deg = 0;
+	const double PI = 3.14159265358979323846;
+
+	for (deg = 0; deg <= 360; deg++) {
+		theta = (deg * PI) / 180.0f;
+		cosines[deg] = cos(theta);
+		sines[deg] = sin(theta);
+	}
+}
+
+/** checkCircle
+ * Check that every point of a circle fits on the canvas, without drawing it
+ *
+ * @param Page *page	The Page struct that holds the canvas
+ * @param int x1		The x-coordinate of the circle origin
+ * @param int y1		The y-coordinate of the circle origin
+ * @param int r		The radius of the circle
+ */
+Error checkCircle(Page *page, int x, int y, int r) {
+	int deg = 0, i = 0, j = 0;
+
+	pthread_once(&anglesOnce, angles);
+	for (deg = 0; deg <= 360; deg++) {
+		i = x + r * cosines[deg] + 0.5;
+		j = y + r * sines[deg] + 0.5;
+
+		if (i >= page->x) return MAX_WIDTH;
+		if (j >= page->y) return MAX_HEIGHT;
+		if (i < 0) return MIN_WIDTH;
+		if (j < 0) return MIN_HEIGHT;
+	}
+
+	return NO_ERROR;
+}
+
 /** drawCircle
  * Draw a circle (unfilled) of certain radius onto the canvas
  *
@@ -117,40 +506,42 @@ Error drawRect(Page *page, int x1, int y1, int x2, int y2, int delete) {
  * @param int delete	Whether the shape is being deleted or drawn
  */
 Error drawCircle(Page *page, int x, int y, int r, int delete) {
-	float theta = 0.0f;
 	int deg = 0, i = 0, j = 0;
-	const double PI = 3.14159265358979323846;
 	char draw = '*';
 	if (delete) {
 		draw = '.';
 	}
 
 	/* First run to check if safe to draw */
-	for (deg = 0; deg <= 360; deg++) {
-		theta = (deg * PI) / 180.0f;
-		i = x + r * cos(theta) + 0.5;
-		j = y + r * sin(theta) + 0.5;
-
-		if (i >= page->x) return MAX_WIDTH;
-		if (j >= page->y) return MAX_HEIGHT;
-		if (i < 0) return MIN_WIDTH;
-		if (j < 0) return MIN_HEIGHT;
-	}
+	Error err = checkCircle(page, x, y, r);
+	if (err != NO_ERROR) return err;
 
-	/* Only draw once all points confirmed safe */
+	/* Only draw once all points confirmed safe, checkCircle having filled in the angles */
 	for (deg = 0; deg <= 360; deg++) {
-		theta = (deg * PI) / 180.0f;
-		i = x + r * cos(theta) + 0.5;
-		j = y + r * sin(theta) + 0.5;
+		i = x + r * cosines[deg] + 0.5;
+		j = y + r * sines[deg] + 0.5;
 
-		page->canvas[j][i] = draw;
+		plot(page, i, j, draw);
 	}
 
 	return NO_ERROR;
 }
 
+/** empty
+ * Whether a point of the canvas is empty, read straight from its row when the page is in memory
+ *
+ * @param Page *page	The Page struct that holds the canvas
+ * @param char **rows	The canvas rows of a page in memory, NULL for a mapped page
+ * @param int x		The x-coordinate of the point
+ * @param int y		The y-coordinate of the point
+ */
+static inline int empty(Page *page, char **rows, int x, int y) {
+	if (rows != NULL) return rows[y][x] == '.';
+	return block(page, 0, x, y) == '.';
+}
+
 /** fill
- * Fill a region assuming 4-connected neighborhood recursively
+ * Fill a region assuming 4-connected neighborhood, a row span at a time
  *
  ****************************************
  ** Based on "Digital Picture Processing"
@@ -158,19 +549,71 @@ Error drawCircle(Page *page, int x, int y, int r, int delete) {
  ** Academic Press, Inc.
  ****************************************
  *
+ * Fills the same region as the recursive fill it replaced, but keeps its
+ * seeds on the heap and works along rows, so it stays within a few rows of a
+ * mapped canvas at a time and cannot run out of stack on a large page.
+ *
  * @param Page *page	The Page struct that holds the canvas
- * @param int x1		The x-coordinate of the seed point
- * @param int y1		The y-coordinate of the seed point
+ * @param int x		The x-coordinate of the seed point
+ * @param int y		The y-coordinate of the seed point
+ * @return				1 if the region was filled, 0 if there was not enough memory to finish it
  */
-void fill(Page *page, int x, int y) {
-	if (page->canvas[y][x] == '.') {
-		page->canvas[y][x] = '*';
+int fill(Page *page, int x, int y) {
+	int *seeds, *grown;
+	size_t count = 0, size = 1024;
+	int left, right, i, row, side;
+	char **rows = page->map == NULL ? page->canvas : NULL;
+
+	seeds = (int*)malloc(size * 2 * sizeof(int));
+	if (seeds == NULL) {
+		fprintf(page->out, "Not enough memory to fill the region\r\n");
+		return 0;
+	}
+
+	seeds[count * 2] = x;
+	seeds[count * 2 + 1] = y;
+	count++;
+
+	while (count > 0) {
+		count--;
+		x = seeds[count * 2];
+		y = seeds[count * 2 + 1];
+		if (!empty(page, rows, x, y)) continue;
+
+		/* Widen the seed to the whole run of empty points it sits in */
+		for (left = x; left > 0 && empty(page, rows, left - 1, y); left--);
+		for (right = x; right < page->x - 1 && empty(page, rows, right + 1, y); right++);
+		for (i = left; i <= right; i++) {
+			plot(page, i, y, '*');
+		}
+
+		/* Seed every run of empty points touching the span in the rows below and above */
+		for (side = -1; side <= 1; side += 2) {
+			row = y + side;
+			if (row < 0 || row >= page->y) continue;
 
-		if (x - 1 >= 0)			fill(page, x - 1, y);
-		if (x < page->x - 1)	fill(page, x + 1, y);
-		if (y - 1 >= 0)			fill(page, x, y - 1);
-		if (y < page->y - 1)	fill(page, x, y + 1);
+			for (i = left; i <= right; i++) {
+				if (!empty(page, rows, i, row) || (i > left && empty(page, rows, i - 1, row))) continue;
+
+				if (count == size) {
+					grown = (int*)realloc(seeds, size * 4 * sizeof(int));
+					if (grown == NULL) {
+						free(seeds);
+						fprintf(page->out, "Not enough memory to finish the fill\r\n");
+						return 0;
+					}
+					seeds = grown;
+					size *= 2;
+				}
+				seeds[count * 2] = i;
+				seeds[count * 2 + 1] = row;
+				count++;
+			}
+		}
 	}
+
+	free(seeds);
+	return 1;
 }
 
 /** invert
@@ -179,18 +622,38 @@ void fill(Page *page, int x, int y) {
  * @param Page *page	The Page struct that holds the canvas
  */
 void invert(Page *page) {
-	int i, j;
+	int i, j, k, n, w, rows;
+	unsigned char *row, *out;
 	i = 0;
 	j = 0;
+	advise(page, MADV_SEQUENTIAL);
 	for (i = 0; i < page->y; i++) {
-		for (j = 0; j < page->x; j++) {
-			if (page->canvas[i][j] == '.') {
-				page->canvas[i][j] = '*';
-			} else {
-				page->canvas[i][j] = '.';
+		for (j = 0; j < page->x; j += n) {
+			/* Holding the run in a local lets the compiler vectorize the loop */
+			row = span(page, 0, j, i, &n);
+			for (k = 0; k < n; k++) {
+				row[k] = row[k] == '.' ? '*' : '.';
+			}
+			touch(page, row, n);
+		}
+	}
+
+	if (page->levels == 0) return;
+
+	/* Every level 1 block now counts its area less the points that were set, the levels above are rebuilt from it */
+	w = levelWidth(page, 1);
+	for (i = 0; i < levelHeight(page, 1); i++) {
+		rows = 2 * i + 1 < page->y ? 2 : 1;
+		for (j = 0; j < w; j += n) {
+			out = span(page, 1, j, i, &n);
+			for (k = 0; k < n; k++) {
+				out[k] = rows * 2 - out[k];
 			}
+			touch(page, out, n);
 		}
+		if (page->x & 1) *cell(page, 1, w - 1, i) -= rows;
 	}
+	rebuildLevels(page, 2);
 }
 
 /** clear
@@ -199,33 +662,89 @@ void invert(Page *page) {
  * @param Page *page	The Page struct that holds the canvas
  */
 void clear(Page *page) {
-	int i, j;
+	int i, j, k, n;
+	unsigned char *row;
 	i = 0;
 	j = 0;
+	advise(page, MADV_SEQUENTIAL);
 	for (i = 0; i < page->y; i++) {
-		for (j = 0; j < page->x; j++) {
-			page->canvas[i][j] = '.';
+		for (j = 0; j < page->x; j += n) {
+			row = span(page, 0, j, i, &n);
+			for (k = 0; k < n; k++) {
+				row[k] = '.';
+			}
+			touch(page, row, n);
 		}
 	}
+	for (i = 1; i <= page->levels; i++) {
+		zero(page, page->pyramid[i], levelSize(page, i));
+	}
+	advise(page, MADV_RANDOM);
 }
 
 /** r
- * Redraw the canvas to the console
+ * Redraw the current view of the canvas to the console
+ *
+ * Each character printed stands for one 2^zoom x 2^zoom block, looked up
+ * directly in the pyramid, so the cost depends only on the output size.
  *
  * @param Page *page	The Page struct that holds the canvas
  */
 void r(Page *page) {
-	int i, j;
-	i = 0;
-	j = 0;
-	for (i = page->y - 1; i >= 0; i--) {
-		for (j = 0; j < page->x; j++) {
-			printf("%c ", page->canvas[i][j]);
+	int i, j, x1, y1, x2, y2;
+	x1 = page->viewX >> page->zoom;
+	y1 = page->viewY >> page->zoom;
+	x2 = (page->viewX + page->viewW - 1) >> page->zoom;
+	y2 = (page->viewY + page->viewH - 1) >> page->zoom;
+	for (i = y2; i >= y1; i--) {
+		for (j = x1; j <= x2; j++) {
+			fprintf(page->out, "%c ", block(page, page->zoom, j, i));
 		}
-		printf("\r\n");
+		fprintf(page->out, "\r\n");
 	}
 }
 
+/** setView
+ * Set the region of the canvas printed by r
+ *
+ * @param Page *page	The Page struct that holds the canvas
+ * @param int x		The bottom-left x-coordinate of the view
+ * @param int y		The bottom-left y-coordinate of the view
+ * @param int w		The width of the view
+ * @param int h		The height of the view
+ * @return				1 if the view was set, 0 if it does not lie within the canvas
+ */
+int setView(Page *page, int x, int y, int w, int h) {
+	/* Compared without adding, so a huge width or height cannot overflow past the check */
+	if (x < 0 || y < 0 || w <= 0 || h <= 0 || x >= page->x || y >= page->y || w > page->x - x || h > page->y - y) {
+		fprintf(page->out, "View must be at least one point wide and high and lie within the %d by %d canvas\r\n", page->x, page->y);
+		return 0;
+	}
+
+	page->viewX = x;
+	page->viewY = y;
+	page->viewW = w;
+	page->viewH = h;
+
+	return 1;
+}
+
+/** setZoom
+ * Set the zoom level used by r, each printed point covering 2^zoom points
+ *
+ * @param Page *page	The Page struct that holds the canvas
+ * @param int zoom	The zoom level, 0 being full size
+ * @return				1 if the zoom was set, 0 if there is no such level
+ */
+int setZoom(Page *page, int zoom) {
+	if (zoom < 0 || zoom > page->levels) {
+		fprintf(page->out, "Zoom level must be between 0 and %d\r\n", page->levels);
+		return 0;
+	}
+	page->zoom = zoom;
+	return 1;
+}
+
 /** undraw
  * Undraw a given shape to the canvas
  *
@@ -251,48 +770,218 @@ void undraw(Page *page, char *shape, int param1, int param2, int param3, int par
 /** printError
  * Print out the error caused by drawing a polygon
  *
+ * @param Page *page	The Page struct whose output stream is written to
  * @param char *polygon	The shape that failed to draw
  * @param Error err		The nature of the error
  */
-void printError(char *polygon, Error err) {
-	printf("Error: %s could not be drawn, it exceeds the ", polygon);
+void printError(Page *page, char *polygon, Error err) {
+	fprintf(page->out, "Error: %s could not be drawn, it exceeds the ", polygon);
 	switch (err) {
 		case MAX_HEIGHT:
-			printf("maximum height");
+			fprintf(page->out, "maximum height");
 			break;
 		case MAX_WIDTH:
-			printf("maximum width");
+			fprintf(page->out, "maximum width");
 			break;
 		case MIN_HEIGHT:
-			printf("minimum height");
+			fprintf(page->out, "minimum height");
 			break;
 		case MIN_WIDTH:
-			printf("minimum width");
+			fprintf(page->out, "minimum width");
 			break;
 	}
-	printf(" of screen.\r\n");
+	fprintf(page->out, " of screen.\r\n");
 }
 
-/** new
- * Create a new canvas of given size
+/** mapPage
+ * Map the canvas and pyramid of a page from its file
+ *
+ * The file holds a header, then the canvas from the bottom, then each pyramid level in turn, each of them tiled if large.
+ * A created file has its blocks reserved up front, so running out of disk fails here rather than
+ * faulting part way through a write. It gets no header until new has cleared it, and is removed
+ * again if it cannot be reserved or mapped
+ *
+ * @param Page *page	The Page struct that holds the canvas, with its size and path set
+ * @param int create	Whether to create a new file rather than open a saved one
+ * @return				1 if the file was mapped, 0 otherwise
+ */
+static int mapPage(Page *page, int create) {
+	struct stat info;
+	size_t offset;
+	char *map;
+	int fd, i;
+
+	page->mapSize = HEADER_SIZE + levelSize(page, 0);
+	for (i = 1; i <= page->levels; i++) {
+		page->mapSize += levelSize(page, i);
+	}
+
+	/* One more than the chunks it spans in case the mapping does not start on a chunk boundary */
+	page->chunks = (unsigned char*)calloc(page->mapSize / MAP_CHUNK + 2, 1);
+	if (page->chunks == NULL) return 0;
+
+	/* Never overwrite an existing file, saved canvases are opened with loadPage instead */
+	fd = open(page->path, create ? O_RDWR | O_CREAT | O_EXCL : O_RDWR, 0644);
+	if (fd < 0) return 0;
+
+	if (create ? (posix_fallocate(fd, 0, page->mapSize) != 0) : (fstat(fd, &info) != 0 || (size_t)info.st_size != page->mapSize)) {
+		close(fd);
+		if (create) unlink(page->path);
+		return 0;
+	}
+
+	map = (char*)mmap(NULL, page->mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		if (create) unlink(page->path);
+		return 0;
+	}
+
+	page->map = map;
+	page->chunkCount = chunkOf(page, map + page->mapSize - 1) + 1;
+	madvise(map, page->mapSize, MADV_RANDOM);
+
+	page->pixels = map + HEADER_SIZE;
+	offset = HEADER_SIZE + levelSize(page, 0);
+	for (i = 1; i <= page->levels; i++) {
+		page->pyramid[i] = (unsigned char*)map + offset;
+		offset += levelSize(page, i);
+	}
+
+	return 1;
+}
+
+/** allocatePage
+ * Allocate or map the canvas and pyramid for a page of given size, leaving their contents unset
  *
  * @param Page *page	The Page struct that holds the canvas
  * @param int x		The width of the canvas
  * @param int y		The height of the canvas
+ * @param int create	Whether a mapped page creates its file rather than opening a saved one
+ * @return				1 if everything could be allocated, 0 otherwise
  */
-void new(Page *page, int x, int y) {
-	int i, j;
-	i = 0;
-	j = 0;
+static int allocatePage(Page *page, int x, int y, int create) {
+	int i;
 
 	page->x = x;
 	page->y = y;
-	page->canvas = (char**)malloc(page->y * sizeof(char*));
-	
-	for (i = 0; i < page->y; i++) {
-		page->canvas[i] = (char*)malloc(page->x * sizeof(char));
-		for (j = 0; j < page->x; j++) {
-			page->canvas[i][j] = '.';
+	page->pixels = NULL;
+	page->map = NULL;
+	page->chunks = NULL;
+	page->touched = 0;
+	page->hand = 0;
+
+	/* Enough levels for the top one to be a single block covering the whole canvas */
+	page->levels = 0;
+	while ((1L << page->levels) < page->x || (1L << page->levels) < page->y) {
+		page->levels++;
+	}
+
+	/* A tiled canvas has no rows to point at, so its points are only reached through the functions here */
+	page->canvas = tiled(page, 0) ? NULL : (char**)malloc(page->y * sizeof(char*));
+	page->pyramid = (unsigned char**)calloc(page->levels + 1, sizeof(unsigned char*));
+	if ((page->canvas == NULL && !tiled(page, 0)) || page->pyramid == NULL) {
+		deallocatePage(page);
+		return 0;
+	}
+
+	if (page->path != NULL) {
+		if (!mapPage(page, create)) {
+			deallocatePage(page);
+			return 0;
+		}
+	} else {
+		page->pixels = (char*)malloc((size_t)page->x * page->y);
+		for (i = 1; i <= page->levels; i++) {
+			page->pyramid[i] = (unsigned char*)malloc(levelSize(page, i));
+			if (page->pyramid[i] == NULL) break;
+		}
+		if (page->pixels == NULL || i <= page->levels) {
+			deallocatePage(page);
+			return 0;
 		}
 	}
+
+	for (i = 0; page->canvas != NULL && i < page->y; i++) {
+		page->canvas[i] = page->pixels + (size_t)i * page->x;
+	}
+
+	page->viewX = 0;
+	page->viewY = 0;
+	page->viewW = x;
+	page->viewH = y;
+	page->zoom = 0;
+
+	return 1;
+}
+
+/** new
+ * Create a new canvas of given size
+ *
+ * @param Page *page	The Page struct that holds the canvas
+ * @param int x		The width of the canvas
+ * @param int y		The height of the canvas
+ * @return				1 if the canvas was created, 0 if there was not enough memory or its file could not be made
+ */
+int new(Page *page, int x, int y) {
+	if (!allocatePage(page, x, y, 1)) return 0;
+	clear(page);
+
+	/* Only a fully cleared file is marked as a canvas, so loadPage never opens a half made one */
+	if (page->map != NULL) snprintf(page->map, HEADER_SIZE, "DRAW %d %d\n", page->x, page->y);
+	return 1;
+}
+
+/** loadPage
+ * Open the canvas saved in the page's file
+ *
+ * @param Page *page	The Page struct that holds the canvas, with its path set
+ * @return				1 if the file held a canvas, 0 otherwise
+ */
+int loadPage(Page *page) {
+	char header[64];
+	int fd, x = 0, y = 0;
+	ssize_t n;
+
+	fd = open(page->path, O_RDONLY);
+	if (fd < 0) return 0;
+	n = read(fd, header, sizeof(header) - 1);
+	close(fd);
+	if (n <= 0) return 0;
+	header[n] = '\0';
+
+	if (sscanf(header, "DRAW %d %d", &x, &y) != 2 || x <= 0 || y <= 0) return 0;
+	if (!allocatePage(page, x, y, 0)) return 0;
+
+	/* The pyramid is rebuilt rather than trusted, in case the last run stopped part way through a change */
+	rebuildPyramid(page);
+	return 1;
+}
+
+/** deallocatePage
+ * Free the canvas and zoom pyramid created by new, writing a mapped canvas back to its file
+ *
+ * @param Page *page	The Page struct that holds the canvas
+ */
+void deallocatePage(Page *page) {
+	int i;
+
+	if (page->map != NULL) {
+		msync(page->map, page->mapSize, MS_SYNC);
+		munmap(page->map, page->mapSize);
+		page->map = NULL;
+	} else {
+		free(page->pixels);
+		for (i = 1; page->pyramid != NULL && i <= page->levels; i++) {
+			free(page->pyramid[i]);
+		}
+	}
+	page->pixels = NULL;
+
+	free(page->chunks);
+	free(page->canvas);
+	page->chunks = NULL;
+	free(page->pyramid);
+	page->canvas = NULL;
+	page->pyramid = NULL;
 }
@@ -21,10 +21,33 @@
 
 /** Page
  * Page structure that holds the canvas and its boundaries
+ *
+ * The canvas rows all point into pixels, one row-major block of x * y points.
+ *
+ * pyramid[l] (1 <= l <= levels) holds one byte per 2^l x 2^l block of the
+ * canvas, counting how many of its four child blocks contain a set pixel.
+ * A block is drawn as '*' when zoomed out if its count is non-zero.
+ *
+ * When path is set, new maps pixels and the pyramid from that file instead
+ * of allocating them. Levels of a mapped page larger than a tile each way are
+ * stored in 256 x 256 tiles instead of rows, and such a canvas has no row
+ * pointers. map is the whole mapping, split into chunks the size
+ * of one fault. chunks records whether each is resident and recently used,
+ * touched counts the bytes of resident chunks, and hand is where the next
+ * search for cold chunks to give back starts.
  */
 typedef struct page {
 	char **canvas;
+	char *pixels;
 	int x, y;
+	unsigned char **pyramid;
+	int levels;
+	int viewX, viewY, viewW, viewH, zoom;
+	FILE *out;
+	char *path;
+	void *map;
+	unsigned char *chunks;
+	size_t mapSize, touched, chunkCount, hand;
 } Page;
 
 typedef enum Error {
@@ -35,14 +58,24 @@ typedef enum Error {
 	MIN_WIDTH
 } Error;
 
+void plot(Page *page, int x, int y, char draw);
+void rebuildPyramid(Page *page);
+Error checkLine(Page *page, int x1, int y1, int x2, int y2);
+Error checkRect(Page *page, int x1, int y1, int x2, int y2);
+Error checkCircle(Page *page, int x, int y, int r);
 Error drawLine(Page *page, int x1, int y1, int x2, int y2, int delete);
 Error drawRect(Page *page, int x1, int y1, int x2, int y2, int delete);
 Error drawCircle(Page *page, int x, int y, int r, int delete);
-void fill(Page *page, int x, int y);
+void undraw(Page *page, char *shape, int param1, int param2, int param3, int param4);
+int fill(Page *page, int x, int y);
 void invert(Page *page);
 void clear(Page *page);
 void r(Page *page);
-void printError(char* polygon, Error err);
-void new(Page *page, int x, int y);
+int setView(Page *page, int x, int y, int w, int h);
+int setZoom(Page *page, int zoom);
+void printError(Page *page, char* polygon, Error err);
+int new(Page *page, int x, int y);
+int loadPage(Page *page);
+void deallocatePage(Page *page);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,360 @@
+/**
+ * harness.c
+ * Differential test and benchmark for the drawing functions
+ *
+ * Generates random canvases and shape workloads from a seed, runs every
+ * workload through both the reference functions in reference.c and the
+ * optimized ones in drawing.c, and compares the resulting canvases and zoom
+ * pyramids byte for byte along with the errors returned. The time taken by
+ * each side is reported per primitive in the same run.
+ *
+ * Lines that differ from referenceLine are compared again against
+ * correctedLine, the documented exact rounding drawLine could move to, and
+ * only count as a mismatch if they differ from that too.
+ *
+ * @author Dan Foad, Alexander Owen-Meehan
+ * @version 0.1.0
+ *
+ *THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *THE SOFTWARE.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+#include "drawing.h"
+#include "reference.h"
+
+#define HARNESS_STACK (512 * 1024 * 1024)	/* referenceFill recurses once per point it fills */
+#define FILL_LIMIT 1024						/* Largest side of a canvas given to referenceFill */
+#define SHAPES 200
+#define FILLS 20
+#define INVERTS 4
+
+enum { LINE, CIRCLE, FILL, INVERT, PRIMITIVES };
+
+/** Result
+ * What one primitive did over every round
+ */
+typedef struct Result {
+	char *name;
+	double reference, optimized;
+	int rounds, corrected, mismatched;
+} Result;
+
+static Result results[PRIMITIVES] = {
+	{ "drawLine" },
+	{ "drawCircle" },
+	{ "fill" },
+	{ "invert" }
+};
+
+static unsigned long long state;
+static int rounds;
+
+/** randomNumber
+ * The next number from a xorshift generator, the same on every platform for a given seed
+ */
+static unsigned int randomNumber(void) {
+	state ^= state >> 12;
+	state ^= state << 25;
+	state ^= state >> 27;
+	return (unsigned int)((state * 2685821657736338717ULL) >> 32);
+}
+
+/** between
+ * A random number from low to high inclusive
+ */
+static int between(int low, int high) {
+	return low + (int)(randomNumber() % (unsigned int)(high - low + 1));
+}
+
+/** now
+ * The current time in seconds from a monotonic clock
+ */
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/** samePage
+ * Whether two pages of the same size have identical canvases and pyramids
+ */
+static int samePage(Page *a, Page *b) {
+	int l;
+	size_t size;
+
+	if (memcmp(a->pixels, b->pixels, (size_t)a->x * a->y) != 0) return 0;
+	for (l = 1; l <= a->levels; l++) {
+		size = (size_t)((a->x + (1L << l) - 1) >> l) * ((a->y + (1L << l) - 1) >> l);
+		if (memcmp(a->pyramid[l], b->pyramid[l], size) != 0) return 0;
+	}
+	return 1;
+}
+
+/** blankPage
+ * Create an empty in-memory page, exiting if there is not enough memory
+ */
+static void blankPage(Page *page, int x, int y) {
+	memset(page, 0, sizeof(Page));
+	page->out = stdout;
+	if (!new(page, x, y)) {
+		printf("Could not create a %d by %d canvas\r\n", x, y);
+		exit(1);
+	}
+}
+
+/** scene
+ * Draw the same random outlines onto two pages for fill and invert to work on
+ */
+static void scene(Page *a, Page *b) {
+	int i, x1, y1, x2, y2, r;
+
+	for (i = 0; i < SHAPES / 10; i++) {
+		x1 = between(0, a->x - 1);
+		y1 = between(0, a->y - 1);
+		x2 = between(0, a->x - 1);
+		y2 = between(0, a->y - 1);
+		referenceLine(a, x1, y1, x2, y2, 0);
+		referenceLine(b, x1, y1, x2, y2, 0);
+
+		r = between(0, (a->x < a->y ? a->x : a->y) / 2);
+		referenceCircle(a, x1, y1, r, 0);
+		referenceCircle(b, x1, y1, r, 0);
+	}
+}
+
+/** record
+ * Add one round of a primitive to its results
+ *
+ * @param int primitive		Which primitive the round was for
+ * @param double reference	Seconds taken by the reference function
+ * @param double optimized	Seconds taken by the optimized function
+ * @param int same			Whether both sides ended up identical
+ */
+static void record(int primitive, double reference, double optimized, int same) {
+	results[primitive].reference += reference;
+	results[primitive].optimized += optimized;
+	results[primitive].rounds++;
+	if (!same) results[primitive].mismatched++;
+}
+
+/** lines
+ * One round of random lines, some of them off the canvas and some undrawing
+ */
+static void lines(int x, int y) {
+	Page reference, optimized, corrected;
+	int p[SHAPES][5], i, same = 1;
+	Error errors[SHAPES];
+	double start, referenceTime, optimizedTime;
+
+	for (i = 0; i < SHAPES; i++) {
+		p[i][0] = between(-2, x + 1);
+		p[i][1] = between(-2, y + 1);
+		p[i][2] = between(-2, x + 1);
+		p[i][3] = between(-2, y + 1);
+		p[i][4] = between(0, 4) == 0;
+	}
+
+	blankPage(&reference, x, y);
+	blankPage(&optimized, x, y);
+
+	start = now();
+	for (i = 0; i < SHAPES; i++) errors[i] = referenceLine(&reference, p[i][0], p[i][1], p[i][2], p[i][3], p[i][4]);
+	referenceTime = now() - start;
+
+	start = now();
+	for (i = 0; i < SHAPES; i++) {
+		if (drawLine(&optimized, p[i][0], p[i][1], p[i][2], p[i][3], p[i][4]) != errors[i]) same = 0;
+	}
+	optimizedTime = now() - start;
+
+	/* Only a difference in points can be explained by the corrected rounding */
+	if (same && !samePage(&reference, &optimized)) {
+		blankPage(&corrected, x, y);
+		for (i = 0; i < SHAPES; i++) correctedLine(&corrected, p[i][0], p[i][1], p[i][2], p[i][3], p[i][4]);
+		if (samePage(&corrected, &optimized)) {
+			results[LINE].corrected++;
+		} else {
+			same = 0;
+		}
+		deallocatePage(&corrected);
+	}
+
+	record(LINE, referenceTime, optimizedTime, same);
+	deallocatePage(&reference);
+	deallocatePage(&optimized);
+}
+
+/** circles
+ * One round of random circles, some of them off the canvas and some undrawing
+ */
+static void circles(int x, int y) {
+	Page reference, optimized;
+	int p[SHAPES][4], i, same = 1;
+	Error errors[SHAPES];
+	double start, referenceTime, optimizedTime;
+
+	for (i = 0; i < SHAPES; i++) {
+		p[i][0] = between(0, x - 1);
+		p[i][1] = between(0, y - 1);
+		p[i][2] = between(0, (x > y ? x : y) / 2);
+		p[i][3] = between(0, 4) == 0;
+	}
+
+	blankPage(&reference, x, y);
+	blankPage(&optimized, x, y);
+
+	start = now();
+	for (i = 0; i < SHAPES; i++) errors[i] = referenceCircle(&reference, p[i][0], p[i][1], p[i][2], p[i][3]);
+	referenceTime = now() - start;
+
+	start = now();
+	for (i = 0; i < SHAPES; i++) {
+		if (drawCircle(&optimized, p[i][0], p[i][1], p[i][2], p[i][3]) != errors[i]) same = 0;
+	}
+	optimizedTime = now() - start;
+
+	record(CIRCLE, referenceTime, optimizedTime, same && samePage(&reference, &optimized));
+	deallocatePage(&reference);
+	deallocatePage(&optimized);
+}
+
+/** fills
+ * One round of fills from random seeds over random outlines
+ */
+static void fills(int x, int y) {
+	Page reference, optimized;
+	int p[FILLS][2], i;
+	double start, referenceTime, optimizedTime;
+
+	if (x > FILL_LIMIT) x = FILL_LIMIT;
+	if (y > FILL_LIMIT) y = FILL_LIMIT;
+
+	blankPage(&reference, x, y);
+	blankPage(&optimized, x, y);
+	scene(&reference, &optimized);
+
+	for (i = 0; i < FILLS; i++) {
+		p[i][0] = between(0, x - 1);
+		p[i][1] = between(0, y - 1);
+	}
+
+	start = now();
+	for (i = 0; i < FILLS; i++) referenceFill(&reference, p[i][0], p[i][1]);
+	referenceTime = now() - start;
+
+	start = now();
+	for (i = 0; i < FILLS; i++) fill(&optimized, p[i][0], p[i][1]);
+	optimizedTime = now() - start;
+
+	record(FILL, referenceTime, optimizedTime, samePage(&reference, &optimized));
+	deallocatePage(&reference);
+	deallocatePage(&optimized);
+}
+
+/** inverts
+ * One round of inverting a canvas of random outlines
+ */
+static void inverts(int x, int y) {
+	Page reference, optimized;
+	int i;
+	double start, referenceTime, optimizedTime;
+
+	blankPage(&reference, x, y);
+	blankPage(&optimized, x, y);
+	scene(&reference, &optimized);
+
+	start = now();
+	for (i = 0; i < INVERTS; i++) referenceInvert(&reference);
+	referenceTime = now() - start;
+
+	start = now();
+	for (i = 0; i < INVERTS; i++) invert(&optimized);
+	optimizedTime = now() - start;
+
+	record(INVERT, referenceTime, optimizedTime, samePage(&reference, &optimized));
+	deallocatePage(&reference);
+	deallocatePage(&optimized);
+}
+
+/** run
+ * Runs every round, on a thread with room for referenceFill to recurse
+ */
+static void* run(void *arg) {
+	int round, x, y, size;
+
+	for (round = 0; round < rounds; round++) {
+		/* Mostly small canvases, with a few large enough for float rounding to drift */
+		size = between(0, 9);
+		if (size < 6) {
+			x = between(1, 200);
+			y = between(1, 200);
+		} else if (size < 9) {
+			x = between(200, 1200);
+			y = between(200, 1200);
+		} else {
+			x = between(1200, 5000);
+			y = between(1200, 5000);
+		}
+
+		lines(x, y);
+		circles(x, y);
+		fills(x, y);
+		inverts(x, y);
+	}
+
+	return NULL;
+}
+
+int main(int argc, char *argv[]) {
+
+	pthread_attr_t attr;
+	pthread_t thread;
+	unsigned long long seed = 1;
+	int i, failed = 0;
+
+	if (argc > 3) {
+		printf("Usage: %s [seed] [rounds]\r\n", argv[0]);
+		return 1;
+	}
+	if (argc > 1) seed = strtoull(argv[1], NULL, 10);
+	rounds = argc > 2 ? atoi(argv[2]) : 20;
+	state = seed ? seed : 1;
+
+	pthread_attr_init(&attr);
+	pthread_attr_setstacksize(&attr, HARNESS_STACK);
+	if (pthread_create(&thread, &attr, run, NULL) != 0) {
+		perror("Could not start harness");
+		return 1;
+	}
+	pthread_join(thread, NULL);
+	pthread_attr_destroy(&attr);
+
+	printf("Seed %llu, %d rounds\r\n", seed, rounds);
+	printf("%-12s %14s %14s %9s  %s\r\n", "primitive", "reference ms", "optimized ms", "speedup", "result");
+	for (i = 0; i < PRIMITIVES; i++) {
+		printf("%-12s %14.2f %14.2f %8.2fx  ", results[i].name, results[i].reference * 1e3, results[i].optimized * 1e3,
+			results[i].optimized > 0 ? results[i].reference / results[i].optimized : 0.0);
+		if (results[i].mismatched > 0) {
+			printf("MISMATCH in %d of %d rounds", results[i].mismatched, results[i].rounds);
+			failed = 1;
+		} else if (results[i].corrected > 0) {
+			printf("identical, %d of %d rounds only to the corrected rounding", results[i].corrected, results[i].rounds);
+		} else {
+			printf("identical");
+		}
+		printf("\r\n");
+	}
+
+	return failed;
+}
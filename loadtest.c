@@ -0,0 +1,227 @@
+/**
+ * loadtest.c
+ * Load test client for the drawing server
+ *
+ * Opens many concurrent sessions against a server started with
+ * "draw serve <socket>", has each of them run the same script of drawing
+ * commands, and reports throughput and latency percentiles. A command's
+ * latency is the time from sending it to receiving the next prompt.
+ *
+ * @author Dan Foad, Alexander Owen-Meehan
+ * @version 0.1.0
+ *
+ *THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *THE SOFTWARE.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define CLIENT_STACK (256 * 1024)
+
+/* Every session cycles through this script, which adds and deletes as many shapes as it draws */
+static char *script[] = {
+	"line 0 0 63 31",
+	"circle 32 16 10",
+	"rect 5 5 20 20",
+	"r",
+	"zoom 2",
+	"r",
+	"zoom 0",
+	"list",
+	"invert",
+	"invert",
+	"delete 1",
+	"delete 1",
+	"delete 1"
+};
+
+#define SCRIPT_LENGTH (sizeof(script) / sizeof(script[0]))
+
+/** Load
+ * What each session thread is given and what it reports back
+ */
+typedef struct Load {
+	char *path;
+	int commands, failed;
+	double *latencies;
+} Load;
+
+/** now
+ * The current time in seconds from a monotonic clock
+ */
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/** waitPrompt
+ * Reads from the server until its output ends with a prompt
+ *
+ * @param int fd	The connected socket
+ * @return			1 once the prompt arrives, 0 if the connection fails
+ */
+static int waitPrompt(int fd) {
+
+	char buffer[65536];
+	char last[2] = { 0, 0 };
+	ssize_t n;
+
+	for (;;) {
+		n = read(fd, buffer, sizeof(buffer));
+		if (n <= 0) return 0;
+
+		if (n >= 2) {
+			last[0] = buffer[n - 2];
+			last[1] = buffer[n - 1];
+		} else {
+			last[0] = last[1];
+			last[1] = buffer[0];
+		}
+		if (last[0] == '>' && last[1] == ' ') return 1;
+	}
+}
+
+/** sendLine
+ * Sends one command line to the server
+ *
+ * @param int fd			The connected socket
+ * @param char *command	The command to send, without its newline
+ */
+static int sendLine(int fd, char *command) {
+
+	char line[64];
+	int length = snprintf(line, sizeof(line), "%s\n", command);
+
+	return send(fd, line, length, MSG_NOSIGNAL) == length;
+}
+
+/** session
+ * Runs one session's share of the load
+ *
+ * @param void *arg	The Load the session records its latencies into
+ */
+static void* session(void *arg) {
+
+	Load *load = (Load*)arg;
+	struct sockaddr_un address;
+	double start;
+	int fd, i;
+
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strncpy(address.sun_path, load->path, sizeof(address.sun_path) - 1);
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0 || connect(fd, (struct sockaddr*)&address, sizeof(address)) < 0 || !waitPrompt(fd)
+			|| !sendLine(fd, "new 64 32") || !waitPrompt(fd)) {
+		load->failed = 1;
+		if (fd >= 0) close(fd);
+		return NULL;
+	}
+
+	for (i = 0; i < load->commands; i++) {
+		start = now();
+		if (!sendLine(fd, script[i % SCRIPT_LENGTH]) || !waitPrompt(fd)) {
+			load->failed = 1;
+			break;
+		}
+		load->latencies[i] = now() - start;
+	}
+
+	sendLine(fd, "exit");
+	close(fd);
+
+	return NULL;
+}
+
+/** compare
+ * Orders latencies for qsort
+ */
+static int compare(const void *a, const void *b) {
+	double x = *(const double*)a, y = *(const double*)b;
+	return (x > y) - (x < y);
+}
+
+int main(int argc, char *argv[]) {
+
+	Load *loads;
+	pthread_t *threads;
+	pthread_attr_t attr;
+	double *latencies, start, elapsed;
+	int sessions, commands, i, j, total = 0, failed = 0;
+
+	if (argc != 4) {
+		printf("Usage: %s <socket> <sessions> <commands per session>\r\n", argv[0]);
+		return 1;
+	}
+	sessions = atoi(argv[2]);
+	commands = atoi(argv[3]);
+	if (sessions <= 0 || commands <= 0) {
+		printf("Sessions and commands must be greater than zero\r\n");
+		return 1;
+	}
+
+	loads = (Load*)calloc(sessions, sizeof(Load));
+	threads = (pthread_t*)malloc(sessions * sizeof(pthread_t));
+	latencies = (double*)malloc((size_t)sessions * commands * sizeof(double));
+
+	pthread_attr_init(&attr);
+	pthread_attr_setstacksize(&attr, CLIENT_STACK);
+
+	start = now();
+	for (i = 0; i < sessions; i++) {
+		loads[i].path = argv[1];
+		loads[i].commands = commands;
+		loads[i].latencies = latencies + (size_t)i * commands;
+		pthread_create(&threads[i], &attr, session, &loads[i]);
+	}
+	for (i = 0; i < sessions; i++) {
+		pthread_join(threads[i], NULL);
+	}
+	elapsed = now() - start;
+
+	/* Only sessions that ran their whole script are counted */
+	for (i = 0; i < sessions; i++) {
+		if (loads[i].failed) {
+			failed++;
+			continue;
+		}
+		for (j = 0; j < commands; j++) {
+			latencies[total++] = loads[i].latencies[j];
+		}
+	}
+
+	printf("Sessions: %d (%d failed)\r\n", sessions, failed);
+	printf("Commands: %d in %.3f s, %.0f commands/s\r\n", total, elapsed, total / elapsed);
+
+	if (total > 0) {
+		qsort(latencies, total, sizeof(double), compare);
+		printf("Latency p50 %.1f us, p90 %.1f us, p99 %.1f us, p99.9 %.1f us, max %.1f us\r\n",
+			latencies[total / 2] * 1e6,
+			latencies[(int)(total * 0.9)] * 1e6,
+			latencies[(int)(total * 0.99)] * 1e6,
+			latencies[(int)(total * 0.999)] * 1e6,
+			latencies[total - 1] * 1e6);
+	}
+
+	pthread_attr_destroy(&attr);
+	free(latencies);
+	free(threads);
+	free(loads);
+
+	return failed > 0;
+}
@@ -18,135 +18,83 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <unistd.h>
 #include "drawing.h"
 #include "command.h"
+#include "session.h"
+#include "server.h"
+#include "batch.h"
 
-int main(void) {
-
-	Page *page;
-	page = (Page*)malloc(sizeof(Page));
-	Error err = NO_ERROR;
-	Command *root = createElement("root", 0, 0, 0, 0);
-	Command *element;
-
-	int i = 0, j = 0, selection = 0, flag = 0, newflag = 0, param1 = 0, param2 = 0, param3 = 0, param4 = 0;
-	char fullinput[16], command[7];
-
-	/* Declare all of the possible commands in the dictionary */
-	char *valid_commands[11] = {      
-		"new",
-		"r",
-		"clear",
-		"invert",
-		"line",
-		"rect",
-		"circle",
-		"fill",
-		"list",
-		"delete",
-		"exit"
-	};
+int main(int argc, char *argv[]) {
+
+	Session *session;
+	int selection = 0, param1 = 0, param2 = 0, param3 = 0, param4 = 0;
+	char command[7];
+
+	/* Serve many sessions over a Unix domain socket instead of stdin */
+	if (argc == 3 && strcmp(argv[1], "serve") == 0) {
+		return serve(argv[2]);
+	}
+
+	/* Pipelines scripted input through a parser thread and batch executor */
+	if (argc == 2 && strcmp(argv[1], "batch") == 0) {
+		return batch();
+	}
+
+	session = createSession(stdout);
+
+	/* Keeps the canvas in a memory-mapped file, reopening the canvas already saved there */
+	if (argc == 3 && strcmp(argv[1], "map") == 0) {
+		session->page.path = argv[2];
+		if (access(argv[2], F_OK) == 0) {
+			if (!loadPage(&session->page)) {
+				printf("%s does not hold a saved canvas\n", argv[2]);
+				deallocateSession(session);
+				return 1;
+			}
+			session->newflag = 1;
+		}
+	}
 
 	printf("Welcome to the drawing software\n");
 
 	do {
 		do {
 			printf("> ");
-			scanf("%s", command);
-
-			/* If statements used to see how many command parameters are needed for evert specific command, then store those parameters */
-			if (strcmp(command, valid_commands[9]) == 0)
-				scanf("%d", &param1);
-			if ((strcmp(command, valid_commands[0]) == 0) || (strcmp(command, valid_commands[7]) == 0))
-				scanf("%d %d", &param1, &param2);
-			if (strcmp(command, valid_commands[6]) == 0)
-				scanf("%d %d %d", &param1, &param2, &param3);
-			if ((strcmp(command, valid_commands[4]) == 0) || (strcmp(command, valid_commands[5]) == 0))
-				scanf("%d %d %d %d", &param1, &param2, &param3, &param4);
+			scanf("%6s", command);
 
 			/* Checks to see if the command entered is a valid command */
-			for (i = 0; i <= 10; i++) {
-				if (strcmp(command, valid_commands[i]) == 0) {
-					selection = i;                              /* Used for the switch case */
-					flag = 1;
+			selection = findCommand(command);
+
+			/* Reads however many parameters the specific command needs */
+			switch (commandParams(selection)) {
+				case 1:
+					scanf("%d", &param1);
+					break;
+				case 2:
+					scanf("%d %d", &param1, &param2);
+					break;
+				case 3:
+					scanf("%d %d %d", &param1, &param2, &param3);
+					break;
+				case 4:
+					scanf("%d %d %d %d", &param1, &param2, &param3, &param4);
 					break;
-				}
 			}
 
-			if (flag == 0){
-				printf("%s is an illegal command. Please ensure one of the eleven legal commands has been entered\n", command);
+			if (selection < 0) {
+				printf("%s is an illegal command. Please ensure one of the thirteen legal commands has been entered\n", command);
 				/* Effectively clears the end of the scanf input buffer by directly going to the end of it */
 				fseek(stdin, 0, SEEK_END);
 			}
-		} while (flag == 0);        /* Only progresses the program if a valid command has been entered */
-
-		switch (selection) {
-			case 0:
-				/* Checks to ensure that the new command has only been entered once in the program run */
-				if (newflag == 1) {
-					printf("'New' cannot be executed more than once, please enter another command\n");
-					break;
-				}
-				newflag = 1;
-				new(page, param1, param2);
-				break;
-			case 1:
-				r(page);
-				break;
-			case 2:
-				clear(page);
-				clearLinkedList(page, root);
-				break;
-			case 3:
-				invert(page);
-				break;
-			case 4:
-				err = drawLine(page, param1, param2, param3, param4, 0);
-				if (err != NO_ERROR) {
-					printError("line", err);
-				} else {
-					element = createElement(command, param1, param2, param3, param4);
-					pushElement(root, element);
-				}
-				break;
-			case 5:
-				err = drawRect(page, param1, param2, param3, param4, 0);
-				if (err != NO_ERROR) {
-					printError("rectangle", err);
-				} else {
-					element = createElement(command, param1, param2, param3, param4);
-					pushElement(root, element);
-				}
-				break;
-			case 6:
-				err = drawCircle(page, param1, param2, param3, 0);
-				if (err != NO_ERROR) {
-					printError("circle", err);
-				} else {
-					element = createElement(command, param1, param2, param3, 0);
-					pushElement(root, element);
-				}
-				break;
-			case 7:
-				fill(page, param1, param2);
-				break;
-			case 8:
-				printlist(root);
-				break;
-			case 9:
-				deleteElement(page, root, param1);
-				break;
-			case 10:
-				printf("Quitting Program\r\n");
-				break;
-		}
+		} while (selection < 0);        /* Only progresses the program if a valid command has been entered */
 
-		flag = 0;
+		execute(session, selection, param1, param2, param3, param4);
 
-	} while (selection != 10);
+	} while (selection != EXIT_COMMAND);
 
-	/* Frees all of the elements in the linked list for the previous commands */
-	deallocateLinkedList(root);
+	/* Frees the canvas and all of the elements in the linked list for the previous commands */
+	deallocateSession(session);
 
 	return 0;
 }
\ No newline at end of file
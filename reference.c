@@ -0,0 +1,224 @@
+/**
+ * reference.c
+ * Reference drawing functions
+ *
+ * These are the drawing routines as they were before being optimized, kept
+ * unchanged so the harness can check the optimized ones in drawing.c
+ * against them. They draw through the same plot and rebuildPyramid, so the
+ * zoom pyramid can be compared as well as the canvas.
+ *
+ * correctedLine is the one documented exception. It rounds every point of
+ * the line exactly, where referenceLine rounds in float and so drifts by a
+ * point on lines more than a couple of thousand points long. drawLine keeps
+ * the float rounding, as the exact stepping drew no faster, and
+ * correctedLine is only kept as the alternative it could move to.
+ *
+ * @author Dan Foad, Alexander Owen-Meehan
+ * @version 0.1.0
+ *
+ *THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *THE SOFTWARE.
+ *
+ * IMPORTANT NOTE: Plotting a point to the canvas is [y][x], NOT [x][y]
+ *
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "drawing.h"
+#include "reference.h"
+
+/** referenceLine
+ * Draw a line between two points onto the canvas, rounding in float
+ *
+ * @param Page *page	The Page struct that holds the canvas
+ * @param int x1		The bottom-left x-coordinate of the line
+ * @param int y1		The bottom-left y-coordinate of the line
+ * @param int x2		The top-right x-coordinate of the line
+ * @param int y2		The top-right y-coordinate of the line
+ * @param int delete	Whether the shape is being deleted or drawn
+ */
+Error referenceLine(Page *page, int x1, int y1, int x2, int y2, int delete) {
+	int dx, dy;
+	float i, j;
+	dx = x2 - x1;
+	dy = y2 - y1;
+	i = 0.0f;
+	j = 0.0f;
+	char draw = '*';
+	if (delete) {
+		draw = '.';
+	}
+
+	Error err = checkLine(page, x1, y1, x2, y2);
+	if (err != NO_ERROR) return err;
+
+	/* A line from a point to itself would divide by zero below */
+	if (dx == 0 && dy == 0) {
+		plot(page, x1, y1, draw);
+		return NO_ERROR;
+	}
+
+	if (abs(dx) > abs(dy)) {
+		if (dx > 0) {
+			for (i = 0.0f; i <= dx; i++) {
+				j = ((i * dy) / dx) + 0.5f;
+				plot(page, (int)(x1 + i), (int)(y1 + j), draw);
+			}
+		} else {
+			for (i = 0.0f; i >= dx; i--) {
+				j = ((i * dy) / dx) + 0.5f;
+				plot(page, (int)(x1 + i), (int)(y1 + j), draw);
+			}
+		}
+	} else {
+		if (dy > 0) {
+			for (j = 0.0f; j <= dy; j++) {
+				i = ((j * dx) / dy) + 0.5f;
+				plot(page, (int)(x1 + i), (int)(y1 + j), draw);
+			}
+		} else {
+			for (j = 0.0f; j >= dy; j--) {
+				i = ((j * dx) / dy) + 0.5f;
+				plot(page, (int)(x1 + i), (int)(y1 + j), draw);
+			}
+		}
+	}
+
+	return NO_ERROR;
+}
+
+/** correctedLine
+ * Draw a line between two points onto the canvas, rounding exactly
+ *
+ * Plots the same points referenceLine means to, floor(i * dy / dx + 0.5)
+ * along the longer axis, worked out in integers for every point on its own.
+ *
+ * @param Page *page	The Page struct that holds the canvas
+ * @param int x1		The bottom-left x-coordinate of the line
+ * @param int y1		The bottom-left y-coordinate of the line
+ * @param int x2		The top-right x-coordinate of the line
+ * @param int y2		The top-right y-coordinate of the line
+ * @param int delete	Whether the shape is being deleted or drawn
+ */
+Error correctedLine(Page *page, int x1, int y1, int x2, int y2, int delete) {
+	long long dx, dy, i, n, d;
+	char draw = '*';
+	if (delete) {
+		draw = '.';
+	}
+	dx = x2 - x1;
+	dy = y2 - y1;
+
+	Error err = checkLine(page, x1, y1, x2, y2);
+	if (err != NO_ERROR) return err;
+
+	if (dx == 0 && dy == 0) {
+		plot(page, x1, y1, draw);
+		return NO_ERROR;
+	}
+
+	if (llabs(dx) > llabs(dy)) {
+		for (i = 0; llabs(i) <= llabs(dx); i += dx > 0 ? 1 : -1) {
+			/* floor((2 * i * dy + dx) / (2 * dx)) with a positive denominator */
+			n = dx > 0 ? 2 * i * dy + dx : -(2 * i * dy + dx);
+			d = llabs(2 * dx);
+			plot(page, x1 + i, y1 + (n >= 0 ? n / d : -((-n + d - 1) / d)), draw);
+		}
+	} else {
+		for (i = 0; llabs(i) <= llabs(dy); i += dy > 0 ? 1 : -1) {
+			n = dy > 0 ? 2 * i * dx + dy : -(2 * i * dx + dy);
+			d = llabs(2 * dy);
+			plot(page, x1 + (n >= 0 ? n / d : -((-n + d - 1) / d)), y1 + i, draw);
+		}
+	}
+
+	return NO_ERROR;
+}
+
+/** referenceCircle
+ * Draw a circle (unfilled) of certain radius onto the canvas, working out every point twice
+ *
+ * @param Page *page	The Page struct that holds the canvas
+ * @param int x1		The x-coordinate of the circle origin
+ * @param int y1		The y-coordinate of the circle origin
+ * @param int r		The radius of the circle
+ * @param int delete	Whether the shape is being deleted or drawn
+ */
+Error referenceCircle(Page *page, int x, int y, int r, int delete) {
+	float theta = 0.0f;
+	int deg = 0, i = 0, j = 0;
+	const double PI = 3.14159265358979323846;
+	char draw = '*';
+	if (delete) {
+		draw = '.';
+	}
+
+	/* First run to check if safe to draw */
+	for (deg = 0; deg <= 360; deg++) {
+		theta = (deg * PI) / 180.0f;
+		i = x + r * cos(theta) + 0.5;
+		j = y + r * sin(theta) + 0.5;
+
+		if (i >= page->x) return MAX_WIDTH;
+		if (j >= page->y) return MAX_HEIGHT;
+		if (i < 0) return MIN_WIDTH;
+		if (j < 0) return MIN_HEIGHT;
+	}
+
+	/* Only draw once all points confirmed safe */
+	for (deg = 0; deg <= 360; deg++) {
+		theta = (deg * PI) / 180.0f;
+		i = x + r * cos(theta) + 0.5;
+		j = y + r * sin(theta) + 0.5;
+
+		plot(page, i, j, draw);
+	}
+
+	return NO_ERROR;
+}
+
+/** referenceFill
+ * Fill a region assuming 4-connected neighborhood recursively
+ *
+ * @param Page *page	The Page struct that holds the canvas
+ * @param int x1		The x-coordinate of the seed point
+ * @param int y1		The y-coordinate of the seed point
+ */
+void referenceFill(Page *page, int x, int y) {
+	if (page->canvas[y][x] == '.') {
+		plot(page, x, y, '*');
+
+		if (x - 1 >= 0)			referenceFill(page, x - 1, y);
+		if (x < page->x - 1)	referenceFill(page, x + 1, y);
+		if (y - 1 >= 0)			referenceFill(page, x, y - 1);
+		if (y < page->y - 1)	referenceFill(page, x, y + 1);
+	}
+}
+
+/** referenceInvert
+ * Invert the canvas, replacing . with * and vice-versa, a point at a time
+ *
+ * @param Page *page	The Page struct that holds the canvas
+ */
+void referenceInvert(Page *page) {
+	int i, j;
+	i = 0;
+	j = 0;
+	for (i = 0; i < page->y; i++) {
+		for (j = 0; j < page->x; j++) {
+			if (page->canvas[i][j] == '.') {
+				page->canvas[i][j] = '*';
+			} else {
+				page->canvas[i][j] = '.';
+			}
+		}
+	}
+	rebuildPyramid(page);
+}
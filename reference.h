@@ -0,0 +1,28 @@
+/**
+* reference.h
+* Reference drawing functions header file
+*
+* @author Dan Foad, Alexander Owen-Meehan
+* @version 0.1.0
+*
+*THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*THE SOFTWARE.
+*
+*/
+
+/* Prevent possibly including reference functions multiple times */
+#ifndef REFERENCE
+#define REFERENCE
+
+Error referenceLine(Page *page, int x1, int y1, int x2, int y2, int delete);
+Error correctedLine(Page *page, int x1, int y1, int x2, int y2, int delete);
+Error referenceCircle(Page *page, int x, int y, int r, int delete);
+void referenceFill(Page *page, int x, int y);
+void referenceInvert(Page *page);
+
+#endif
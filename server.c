@@ -0,0 +1,555 @@
+/**
+ * server.c
+ * Serves one drawing session per connection on a Unix domain socket
+ *
+ * A single epoll loop accepts connections, reads command lines and writes
+ * output back, while a pool of worker threads executes the commands. Each
+ * session is only ever run by one worker at a time, so its commands stay in
+ * order. A worker stops taking commands from a session once too much of its
+ * output is unsent, and the loop stops reading from it, so a slow client
+ * only ever holds a bounded amount of memory.
+ *
+ * @author Dan Foad, Alexander Owen-Meehan
+ * @version 0.1.0
+ *
+ *THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *THE SOFTWARE.
+ *
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "drawing.h"
+#include "command.h"
+#include "session.h"
+#include "server.h"
+
+#define MAX_EVENTS 64
+#define INPUT_LIMIT 4096					/* Longest command line a client may send */
+#define OUTPUT_HIGH_WATER (256 * 1024)		/* Unsent output at which a session stops being run */
+#define SESSION_MAX_POINTS (512 * 512)
+#define SESSION_MAX_HISTORY 1024
+
+/** Client
+ * One connection and the session it is drawing in
+ */
+typedef struct Client {
+	int fd, events;
+	Session *session;
+	pthread_mutex_t lock;					/* Guards the input and output buffers */
+	char input[INPUT_LIMIT];
+	size_t inputLength;
+	char *output;
+	size_t outputLength, outputSent, outputSize;
+	int busy, quit, eof, closed, closing;
+	struct Client *next;					/* Position in the work queue, done list or closing list */
+} Client;
+
+/** Server
+ * The listening socket, event loop and the queues shared with the workers
+ */
+typedef struct Server {
+	int epoll, listener, wakeup;
+	pthread_mutex_t lock;					/* Guards the work queue and done list */
+	pthread_cond_t work;
+	Client *workHead, *workTail, *done;
+	Client *closing;						/* Only touched by the event loop, freed once each batch of events is handled */
+} Server;
+
+/** clientWrite
+ * Appends a session's output to its client's output buffer
+ *
+ * @param void *cookie			The client the output belongs to
+ * @param const char *buffer	The output to append
+ * @param size_t size			The number of bytes to append
+ */
+static ssize_t clientWrite(void *cookie, const char *buffer, size_t size) {
+
+	Client *client = (Client*)cookie;
+	size_t grown;
+	char *output;
+
+	pthread_mutex_lock(&client->lock);
+
+	if (client->outputLength + size > client->outputSize) {
+		grown = client->outputSize ? client->outputSize * 2 : 4096;
+		while (grown < client->outputLength + size) grown *= 2;
+
+		output = (char*)realloc(client->output, grown);
+		if (output == NULL) {
+			pthread_mutex_unlock(&client->lock);
+			return 0;
+		}
+		client->output = output;
+		client->outputSize = grown;
+	}
+	memcpy(client->output + client->outputLength, buffer, size);
+	client->outputLength += size;
+
+	pthread_mutex_unlock(&client->lock);
+
+	return size;
+}
+
+/** nextLine
+ * Takes the next complete command line out of a client's input buffer
+ *
+ * @param Client *client	The client to read from
+ * @param char *line		Where to copy the line, at least INPUT_LIMIT bytes
+ * @return					1 if a line was taken, 0 if there is no complete line yet
+ */
+static int nextLine(Client *client, char *line) {
+
+	char *end;
+	size_t length;
+
+	pthread_mutex_lock(&client->lock);
+
+	end = (char*)memchr(client->input, '\n', client->inputLength);
+	if (end == NULL) {
+		pthread_mutex_unlock(&client->lock);
+		return 0;
+	}
+
+	length = end - client->input;
+	memcpy(line, client->input, length);
+	line[length] = '\0';
+	if (length > 0 && line[length - 1] == '\r') line[length - 1] = '\0';
+
+	client->inputLength -= length + 1;
+	memmove(client->input, end + 1, client->inputLength);
+
+	pthread_mutex_unlock(&client->lock);
+
+	return 1;
+}
+
+/** runLine
+ * Parses and executes one command line, followed by a fresh prompt
+ *
+ * @param Client *client	The client the line came from
+ * @param char *line		The command line
+ */
+static void runLine(Client *client, char *line) {
+
+	FILE *out = client->session->page.out;
+	char command[16];
+	int selection = 0, count = 0, n = 0, param1 = 0, param2 = 0, param3 = 0, param4 = 0;
+
+	/* Blank lines are skipped, just like scanf does in interactive mode */
+	if (sscanf(line, "%15s%n", command, &n) != 1) return;
+
+	selection = findCommand(command);
+	if (selection < 0) {
+		fprintf(out, "%s is an illegal command. Please ensure one of the thirteen legal commands has been entered\r\n", command);
+	} else {
+		count = commandParams(selection);
+		if (count > 0 && sscanf(line + n, "%d %d %d %d", &param1, &param2, &param3, &param4) < count) {
+			fprintf(out, "%s needs %d parameters\r\n", command, count);
+		} else {
+			execute(client->session, selection, param1, param2, param3, param4);
+			if (selection == EXIT_COMMAND) client->quit = 1;
+		}
+	}
+
+	if (!client->quit) fprintf(out, "> ");
+	fflush(out);
+}
+
+/** pendingOutput
+ * The number of output bytes not yet sent to the client
+ *
+ * @param Client *client	The client to check
+ */
+static size_t pendingOutput(Client *client) {
+
+	size_t pending;
+
+	pthread_mutex_lock(&client->lock);
+	pending = client->outputLength - client->outputSent;
+	pthread_mutex_unlock(&client->lock);
+
+	return pending;
+}
+
+/** worker
+ * Runs queued sessions until their input or output allowance runs out
+ *
+ * @param void *arg		The server the worker belongs to
+ */
+static void* worker(void *arg) {
+
+	Server *server = (Server*)arg;
+	Client *client;
+	char line[INPUT_LIMIT];
+	uint64_t one = 1;
+
+	for (;;) {
+		pthread_mutex_lock(&server->lock);
+		while (server->workHead == NULL) {
+			pthread_cond_wait(&server->work, &server->lock);
+		}
+		client = server->workHead;
+		server->workHead = client->next;
+		if (server->workHead == NULL) server->workTail = NULL;
+		pthread_mutex_unlock(&server->lock);
+
+		while (!client->quit && pendingOutput(client) < OUTPUT_HIGH_WATER && nextLine(client, line)) {
+			runLine(client, line);
+		}
+
+		/* Hands the client back to the event loop */
+		pthread_mutex_lock(&server->lock);
+		client->next = server->done;
+		server->done = client;
+		pthread_mutex_unlock(&server->lock);
+		write(server->wakeup, &one, sizeof(one));
+	}
+
+	return NULL;
+}
+
+/** closeClient
+ * Disconnects a client and frees its session
+ *
+ * @param Server *server	The server the client is connected to
+ * @param Client *client	The client to close
+ */
+static void closeClient(Server *server, Client *client) {
+
+	epoll_ctl(server->epoll, EPOLL_CTL_DEL, client->fd, NULL);
+	close(client->fd);
+
+	fclose(client->session->page.out);
+	deallocateSession(client->session);
+
+	pthread_mutex_destroy(&client->lock);
+	free(client->output);
+	free(client);
+}
+
+/** watchClient
+ * Changes which events the loop waits for on a client
+ *
+ * @param Server *server	The server the client is connected to
+ * @param Client *client	The client to watch
+ * @param int events		The epoll events to wait for
+ */
+static void watchClient(Server *server, Client *client, int events) {
+
+	struct epoll_event event;
+
+	if (events != client->events) {
+		event.events = events;
+		event.data.ptr = client;
+		epoll_ctl(server->epoll, EPOLL_CTL_MOD, client->fd, &event);
+		client->events = events;
+	}
+}
+
+/** updateClient
+ * Decides what happens next to a client once the loop or a worker is done with it
+ *
+ * Queues it for a worker if it has a complete line and room for more output,
+ * and only watches for input while there is room to buffer it. Clients are
+ * never freed here, as the current batch of events may still refer to them,
+ * but moved to the closing list instead.
+ *
+ * @param Server *server	The server the client is connected to
+ * @param Client *client	The client to update
+ */
+static void updateClient(Server *server, Client *client) {
+
+	size_t pending;
+	int line, full, events = 0;
+
+	if (client->closing) return;
+
+	/* Nothing is read or sent while a worker has the session, and one-shot stops a hang-up firing over and over */
+	if (client->busy) {
+		watchClient(server, client, EPOLLONESHOT);
+		return;
+	}
+
+	pthread_mutex_lock(&client->lock);
+	pending = client->outputLength - client->outputSent;
+	line = memchr(client->input, '\n', client->inputLength) != NULL;
+	full = client->inputLength == INPUT_LIMIT;
+	pthread_mutex_unlock(&client->lock);
+
+	/* A line longer than the input buffer can never be completed */
+	if (full && !line) client->closed = 1;
+
+	if (client->closed || ((client->quit || (client->eof && !line)) && pending == 0)) {
+		client->closing = 1;
+		client->next = server->closing;
+		server->closing = client;
+		return;
+	}
+
+	if (!client->quit && line && pending < OUTPUT_HIGH_WATER) {
+		client->busy = 1;
+		client->next = NULL;
+		pthread_mutex_lock(&server->lock);
+		if (server->workTail) {
+			server->workTail->next = client;
+		} else {
+			server->workHead = client;
+		}
+		server->workTail = client;
+		pthread_cond_signal(&server->work);
+		pthread_mutex_unlock(&server->lock);
+
+		watchClient(server, client, EPOLLONESHOT);
+		return;
+	}
+
+	if (!client->quit && !client->eof && !full && pending < OUTPUT_HIGH_WATER) events |= EPOLLIN;
+	if (pending > 0) events |= EPOLLOUT;
+
+	watchClient(server, client, events);
+}
+
+/** readClient
+ * Reads whatever the client has sent into its input buffer
+ *
+ * @param Client *client	The client to read from
+ */
+static void readClient(Client *client) {
+
+	ssize_t n;
+
+	pthread_mutex_lock(&client->lock);
+
+	/* A zero length read would look just like the client hanging up */
+	if (client->inputLength == INPUT_LIMIT) {
+		pthread_mutex_unlock(&client->lock);
+		return;
+	}
+
+	n = read(client->fd, client->input + client->inputLength, INPUT_LIMIT - client->inputLength);
+	if (n > 0) {
+		client->inputLength += n;
+	} else if (n == 0) {
+		client->eof = 1;
+	} else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+		client->closed = 1;
+	}
+	pthread_mutex_unlock(&client->lock);
+}
+
+/** writeClient
+ * Sends as much pending output as the client will take
+ *
+ * @param Client *client	The client to write to
+ */
+static void writeClient(Client *client) {
+
+	ssize_t n;
+
+	pthread_mutex_lock(&client->lock);
+	n = send(client->fd, client->output + client->outputSent, client->outputLength - client->outputSent, MSG_NOSIGNAL | MSG_DONTWAIT);
+	if (n > 0) {
+		client->outputSent += n;
+	} else if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+		client->closed = 1;
+	}
+
+	/* Rewinds the buffer once drained, dropping it entirely after a large frame */
+	if (client->outputSent == client->outputLength) {
+		client->outputSent = 0;
+		client->outputLength = 0;
+		if (client->outputSize > OUTPUT_HIGH_WATER) {
+			free(client->output);
+			client->output = NULL;
+			client->outputSize = 0;
+		}
+	}
+	pthread_mutex_unlock(&client->lock);
+}
+
+/** acceptClients
+ * Accepts every waiting connection and greets it with a new session
+ *
+ * @param Server *server	The server to accept on
+ */
+static void acceptClients(Server *server) {
+
+	cookie_io_functions_t functions = { NULL, clientWrite, NULL, NULL };
+	struct epoll_event event;
+	Client *client;
+	FILE *out;
+	int fd;
+
+	while ((fd = accept4(server->listener, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+		client = (Client*)calloc(1, sizeof(Client));
+		if (client == NULL) {
+			close(fd);
+			continue;
+		}
+		client->fd = fd;
+		pthread_mutex_init(&client->lock, NULL);
+
+		out = fopencookie(client, "w", functions);
+		client->session = out ? createSession(out) : NULL;
+		if (client->session == NULL) {
+			if (out) fclose(out);
+			close(fd);
+			pthread_mutex_destroy(&client->lock);
+			free(client);
+			continue;
+		}
+		client->session->maxPoints = SESSION_MAX_POINTS;
+		client->session->maxHistory = SESSION_MAX_HISTORY;
+
+		fprintf(out, "Welcome to the drawing software\r\n> ");
+		fflush(out);
+
+		client->events = EPOLLIN;
+		event.events = client->events;
+		event.data.ptr = client;
+		epoll_ctl(server->epoll, EPOLL_CTL_ADD, fd, &event);
+
+		updateClient(server, client);
+	}
+}
+
+/** finishClients
+ * Takes back every client the workers have finished running
+ *
+ * @param Server *server	The server the workers belong to
+ */
+static void finishClients(Server *server) {
+
+	Client *client, *next;
+	uint64_t count;
+
+	read(server->wakeup, &count, sizeof(count));
+
+	pthread_mutex_lock(&server->lock);
+	client = server->done;
+	server->done = NULL;
+	pthread_mutex_unlock(&server->lock);
+
+	while (client != NULL) {
+		next = client->next;
+		client->busy = 0;
+		updateClient(server, client);
+		client = next;
+	}
+}
+
+/** serve
+ * Serves drawing sessions on a Unix domain socket until the process is killed
+ *
+ * @param char *path	The path of the socket to create
+ * @return				Non-zero if the server could not be started
+ */
+int serve(char *path) {
+
+	Server server;
+	struct sockaddr_un address;
+	struct epoll_event event, events[MAX_EVENTS];
+	pthread_attr_t attr;
+	pthread_t thread;
+	Client *client;
+	long workers, i;
+	int n, j;
+
+	signal(SIGPIPE, SIG_IGN);
+	memset(&server, 0, sizeof(server));
+	pthread_mutex_init(&server.lock, NULL);
+	pthread_cond_init(&server.work, NULL);
+
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(address.sun_path)) {
+		printf("Socket path is too long\r\n");
+		return 1;
+	}
+	strcpy(address.sun_path, path);
+	unlink(path);
+
+	server.listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (server.listener < 0 || bind(server.listener, (struct sockaddr*)&address, sizeof(address)) < 0 || listen(server.listener, SOMAXCONN) < 0) {
+		perror("Could not listen on socket");
+		return 1;
+	}
+
+	server.epoll = epoll_create1(EPOLL_CLOEXEC);
+	server.wakeup = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (server.epoll < 0 || server.wakeup < 0) {
+		perror("Could not start event loop");
+		return 1;
+	}
+
+	/* The listener is tagged with NULL and the wakeup with the server itself, clients with their own struct */
+	event.events = EPOLLIN;
+	event.data.ptr = NULL;
+	epoll_ctl(server.epoll, EPOLL_CTL_ADD, server.listener, &event);
+	event.data.ptr = &server;
+	epoll_ctl(server.epoll, EPOLL_CTL_ADD, server.wakeup, &event);
+
+	workers = sysconf(_SC_NPROCESSORS_ONLN);
+	if (workers < 1) workers = 1;
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	for (i = 0; i < workers; i++) {
+		if (pthread_create(&thread, &attr, worker, &server) != 0) {
+			perror("Could not start worker");
+			return 1;
+		}
+	}
+	pthread_attr_destroy(&attr);
+
+	printf("Serving on %s with %ld workers\r\n", path, workers);
+	fflush(stdout);
+
+	for (;;) {
+		n = epoll_wait(server.epoll, events, MAX_EVENTS, -1);
+		if (n < 0 && errno != EINTR) {
+			perror("Event loop failed");
+			return 1;
+		}
+
+		for (j = 0; j < n; j++) {
+			if (events[j].data.ptr == NULL) {
+				acceptClients(&server);
+			} else if (events[j].data.ptr == &server) {
+				finishClients(&server);
+			} else {
+				client = (Client*)events[j].data.ptr;
+				if (client->closing) continue;
+				if (events[j].events & EPOLLERR) client->closed = 1;
+				if (events[j].events & (EPOLLIN | EPOLLHUP)) readClient(client);
+				if (events[j].events & EPOLLOUT) writeClient(client);
+				updateClient(&server, client);
+			}
+		}
+
+		/* Only now is nothing left in the batch that could refer to these */
+		while (server.closing != NULL) {
+			client = server.closing;
+			server.closing = client->next;
+			closeClient(&server, client);
+		}
+	}
+
+	return 0;
+}
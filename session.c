@@ -0,0 +1,222 @@
+/**
+ * session.c
+ * Functions for creating drawing sessions and executing commands against them
+ *
+ * @author Dan Foad, Alexander Owen-Meehan
+ * @version 0.1.0
+ *
+ *THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *THE SOFTWARE.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "drawing.h"
+#include "command.h"
+#include "session.h"
+
+/* Declare all of the possible commands in the dictionary */
+static char *valid_commands[COMMAND_COUNT] = {
+	"new",
+	"r",
+	"clear",
+	"invert",
+	"line",
+	"rect",
+	"circle",
+	"fill",
+	"list",
+	"delete",
+	"exit",
+	"view",
+	"zoom"
+};
+
+/* Number of parameters taken by each command, in the same order as the dictionary */
+static int valid_params[COMMAND_COUNT] = { 2, 0, 0, 0, 4, 4, 3, 2, 0, 1, 0, 4, 1 };
+
+/** createSession
+ * Creates a session with an empty history and no canvas yet
+ *
+ * @param FILE *out	The stream all of the session's output is written to
+ */
+Session* createSession(FILE *out) {
+
+	Session *session;
+
+	session = (Session*)malloc(sizeof(Session));
+
+	if (session) {
+		memset(session, 0, sizeof(Session));
+		session->page.out = out;
+		session->root = createElement("root", 0, 0, 0, 0);
+	}
+
+	return session;
+}
+
+/** deallocateSession
+ * Frees the session's canvas, history and the session itself
+ *
+ * @param Session *session	The session to free
+ */
+void deallocateSession(Session *session) {
+
+	if (session->newflag) {
+		deallocatePage(&session->page);
+	}
+	deallocateLinkedList(session->root);
+	free(session);
+}
+
+/** findCommand
+ * Looks up a command in the dictionary
+ *
+ * @param char *command	The command entered by the user
+ * @return				The position of the command in the dictionary, or -1 if it is illegal
+ */
+int findCommand(char *command) {
+
+	int i = 0;
+
+	for (i = 0; i < COMMAND_COUNT; i++) {
+		if (strcmp(command, valid_commands[i]) == 0) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+/** commandParams
+ * The number of parameters the command needs, none for an illegal command
+ *
+ * @param int selection	The position of the command in the dictionary
+ */
+int commandParams(int selection) {
+	if (selection < 0 || selection >= COMMAND_COUNT) return 0;
+	return valid_params[selection];
+}
+
+/** execute
+ * Executes a single validated command against the session
+ *
+ * @param Session *session	The session the command belongs to
+ * @param int selection		The position of the command in the dictionary
+ * @param int param1		The first parameter entered with the command by the user
+ * @param int param2		The second parameter entered with the command by the user
+ * @param int param3		The third parameter entered with the command by the user
+ * @param int param4		The fourth parameter entered with the command by the user
+ */
+void execute(Session *session, int selection, int param1, int param2, int param3, int param4) {
+
+	Page *page = &session->page;
+	Command *element;
+	Error err = NO_ERROR;
+	char *command = valid_commands[selection];
+
+	/* Everything apart from new, list and exit needs a canvas to work on */
+	if (session->newflag == 0 && selection != 0 && selection != 8 && selection != EXIT_COMMAND) {
+		fprintf(page->out, "No canvas exists yet, please use 'new' first\r\n");
+		return;
+	}
+
+	/* Shapes are only added to a full history once something has been deleted */
+	if (selection >= 4 && selection <= 6 && session->maxHistory > 0 && countElements(session->root) >= session->maxHistory) {
+		fprintf(page->out, "History is full, please delete a command first\r\n");
+		return;
+	}
+
+	switch (selection) {
+		case 0:
+			/* Checks to ensure that the new command has only been entered once in the session */
+			if (session->newflag == 1) {
+				fprintf(page->out, "'New' cannot be executed more than once, please enter another command\r\n");
+				break;
+			}
+			if (param1 <= 0 || param2 <= 0) {
+				fprintf(page->out, "Canvas width and height must be greater than zero\r\n");
+				break;
+			}
+			if (session->maxPoints > 0 && (long)param1 * param2 > session->maxPoints) {
+				fprintf(page->out, "Canvas cannot be larger than %ld points\r\n", session->maxPoints);
+				break;
+			}
+			if (!new(page, param1, param2)) {
+				fprintf(page->out, "A %d by %d canvas could not be created\r\n", param1, param2);
+				break;
+			}
+			session->newflag = 1;
+			break;
+		case 1:
+			r(page);
+			break;
+		case 2:
+			clear(page);
+			clearLinkedList(session->root);
+			break;
+		case 3:
+			invert(page);
+			break;
+		case 4:
+			err = drawLine(page, param1, param2, param3, param4, 0);
+			if (err != NO_ERROR) {
+				printError(page, "line", err);
+			} else {
+				element = createElement(command, param1, param2, param3, param4);
+				pushElement(session->root, element);
+			}
+			break;
+		case 5:
+			err = drawRect(page, param1, param2, param3, param4, 0);
+			if (err != NO_ERROR) {
+				printError(page, "rectangle", err);
+			} else {
+				element = createElement(command, param1, param2, param3, param4);
+				pushElement(session->root, element);
+			}
+			break;
+		case 6:
+			err = drawCircle(page, param1, param2, param3, 0);
+			if (err != NO_ERROR) {
+				printError(page, "circle", err);
+			} else {
+				element = createElement(command, param1, param2, param3, 0);
+				pushElement(session->root, element);
+			}
+			break;
+		case 7:
+			if (param1 >= page->x) err = MAX_WIDTH;
+			if (param2 >= page->y) err = MAX_HEIGHT;
+			if (param1 < 0) err = MIN_WIDTH;
+			if (param2 < 0) err = MIN_HEIGHT;
+			if (err != NO_ERROR) {
+				printError(page, "fill", err);
+			} else {
+				fill(page, param1, param2);
+			}
+			break;
+		case 8:
+			printlist(page, session->root);
+			break;
+		case 9:
+			deleteElement(page, session->root, param1);
+			break;
+		case 10:
+			fprintf(page->out, "Quitting Program\r\n");
+			break;
+		case 11:
+			setView(page, param1, param2, param3, param4);
+			break;
+		case 12:
+			setZoom(page, param1);
+			break;
+	}
+}
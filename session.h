@@ -0,0 +1,44 @@
+/**
+* session.h
+* Drawing session functions header file
+*
+* @author Dan Foad, Alexander Owen-Meehan
+* @version 0.1.0
+*
+*THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*THE SOFTWARE.
+*
+*/
+
+/* Prevent possibly including session functions multiple times */
+#ifndef SESSION
+#define SESSION
+
+#define COMMAND_COUNT 13
+#define EXIT_COMMAND 10
+
+/** Session
+ * Everything belonging to one user: their page, command history and limits
+ *
+ * maxPoints and maxHistory bound the canvas area and history length, 0 meaning unlimited
+ */
+typedef struct Session {
+	Page page;
+	Command *root;
+	int newflag;
+	long maxPoints;
+	int maxHistory;
+} Session;
+
+Session* createSession(FILE *out);
+void deallocateSession(Session *session);
+int findCommand(char *command);
+int commandParams(int selection);
+void execute(Session *session, int selection, int param1, int param2, int param3, int param4);
+
+#endif